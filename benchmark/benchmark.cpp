@@ -0,0 +1,251 @@
+// Times the stages of turning an image into a lithophane: decoding, mesh
+// generation, face normals, export to each file format, loading STL files
+// back for the preview and packing the preview vertex buffer. Each
+// measurement is written as one JSON object per line.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "lithophane.h"
+#include "stlreader.h"
+
+
+namespace {
+
+// Peak resident set size of the whole process so far
+qint64 peakRssKb()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize / 1024;
+    return -1;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(Q_OS_MACOS)
+    return usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+class Report
+{
+public:
+    explicit Report(QFile& file) : m_File(file) {}
+
+    // 'triangles' and 'bytes' are left out of the record when negative
+    void add(const QString& input, int width, int height, const QString& stage,
+             qint64 nsecs, qint64 triangles = -1, qint64 bytes = -1)
+    {
+        const double seconds = std::max<double>(nsecs, 1) / 1e9;
+
+        QJsonObject record;
+        record["input"] = input;
+        record["width"] = width;
+        record["height"] = height;
+        record["stage"] = stage;
+        record["seconds"] = seconds;
+        if (triangles >= 0)
+        {
+            record["triangles"] = triangles;
+            record["triangles_per_second"] = triangles / seconds;
+        }
+        if (bytes >= 0)
+        {
+            record["bytes"] = bytes;
+            record["mb_per_second"] = bytes / 1e6 / seconds;
+        }
+        record["peak_rss_kb"] = peakRssKb();
+
+        m_File.write(QJsonDocument(record).toJson(QJsonDocument::Compact));
+        m_File.write("\n");
+        m_File.flush();
+
+        fprintf(stderr, "%-24s %-14s %10.3f s\n", qPrintable(input), qPrintable(stage), seconds);
+    }
+
+private:
+    QFile& m_File;
+};
+
+// Smooth shapes with some noise on top, so neither flat nor random
+QImage syntheticImage(int size)
+{
+    QImage image(size, size, QImage::Format_Grayscale8);
+    for (int y = 0; y < size; ++y)
+    {
+        uchar *line = image.scanLine(y);
+        for (int x = 0; x < size; ++x)
+        {
+            const float u = (float) x / size, v = (float) y / size;
+            const float shape = std::sin(u * 9.0f) * std::cos(v * 7.0f) * 90.0f;
+            const uint32_t hash = (x * 73856093u) ^ (y * 19349663u);
+            line[x] = (uchar) qBound(0.0f, 128.0f + shape + (float) (hash % 41) - 20.0f, 255.0f);
+        }
+    }
+    return image;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the LithoMaker pipeline on example and synthetic images.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("images", "Additional input images.", "[images...]");
+    QCommandLineOption outputOption({"o", "output"}, "JSON lines output file, '-' for stdout.", "file", "benchmark.jsonl");
+    QCommandLineOption examplesOption("examples", "Directory with example images, empty to skip.", "dir", "examples");
+    QCommandLineOption sizesOption("sizes", "Sizes of the square synthetic images.", "list", "256,512,1024,2048,4096,8192");
+    QCommandLineOption meshLimitOption("mesh-limit", "Largest image side to render in memory. Larger images are only decoded and streamed to disk.", "pixels", "4096");
+    QCommandLineOption asciiLimitOption("ascii-limit", "Largest image side to export as ASCII STL.", "pixels", "2048");
+    parser.addOptions({outputOption, examplesOption, sizesOption, meshLimitOption, asciiLimitOption});
+    parser.process(app);
+
+    const int meshLimit = parser.value(meshLimitOption).toInt();
+    const int asciiLimit = parser.value(asciiLimitOption).toInt();
+
+    QFile output(parser.value(outputOption));
+    const bool opened = output.fileName() == "-" ?
+        output.open(stdout, QIODevice::WriteOnly) :
+        output.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!opened)
+    {
+        fprintf(stderr, "Cannot write to '%s'\n", qPrintable(parser.value(outputOption)));
+        return 1;
+    }
+    Report report(output);
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+    {
+        fprintf(stderr, "Cannot create a temporary directory\n");
+        return 1;
+    }
+
+    // Inputs run smallest first, so the process peak RSS tracks the largest one so far
+    QStringList inputs;
+    if (!parser.value(examplesOption).isEmpty())
+    {
+        for (const QFileInfo& info : QDir(parser.value(examplesOption)).entryInfoList({"*.png", "*.jpg"}, QDir::Files, QDir::Name))
+        {
+            inputs.append(info.filePath());
+        }
+    }
+    inputs.append(parser.positionalArguments());
+    for (const QString& size : parser.value(sizesOption).split(','))
+    {
+        if (size.toInt() < 2) continue;
+        const QString path = tempDir.filePath(QString("synthetic-%1.png").arg(size.toInt()));
+        syntheticImage(size.toInt()).save(path, "PNG");
+        inputs.append(path);
+    }
+
+    const QString stlPath = tempDir.filePath("benchmark.stl");
+    QElapsedTimer timer;
+
+    for (const QString& path : inputs)
+    {
+        const QString name = QFileInfo(path).fileName();
+
+        ImageTiles image;
+        if (!image.open(path))
+        {
+            fprintf(stderr, "Cannot read '%s'\n", qPrintable(path));
+            continue;
+        }
+        const int w = image.width(), h = image.height();
+
+        // Images read strip by strip are decoded again by later stages, the rest is kept
+        timer.start();
+        const bool decoded = !image.read(0, h).isNull();
+        report.add(name, w, h, "decode", timer.nsecsElapsed(), -1, QFileInfo(path).size());
+        if (!decoded) continue;
+
+        Lithophane lithophane;
+        lithophane.configure(image, 200.0f, 4.0f, 0.8f, 3.0f, 0.75f, false, 0.15f, 60.0f, 2);
+
+        timer.start();
+        lithophane.generateToStl(stlPath, true);
+        const qint64 streamed = timer.nsecsElapsed();
+        report.add(name, w, h, "stream_binary_stl", streamed, (QFileInfo(stlPath).size() - 84) / 50, QFileInfo(stlPath).size());
+
+        if (std::max(w, h) > meshLimit) continue;
+
+        timer.start();
+        lithophane.generate();
+        report.add(name, w, h, "generate", timer.nsecsElapsed(), lithophane.getMesh().triangleCount());
+
+        const int triangles = lithophane.getMesh().triangleCount();
+        // Part of generate(), timed again on its own
+        Mesh mesh = lithophane.getMesh();
+        timer.start();
+        mesh.computeNormals();
+        report.add(name, w, h, "normals", timer.nsecsElapsed(), triangles);
+        timer.start();
+        lithophane.saveToStl(stlPath, "binary", true);
+        report.add(name, w, h, "binary_stl", timer.nsecsElapsed(), triangles, QFileInfo(stlPath).size());
+
+        timer.start();
+        const QByteArray loaded = readStlVertexBuffer(stlPath);
+        report.add(name, w, h, "load_stl", timer.nsecsElapsed(), loaded.size() / (3 * 6 * sizeof(float)), QFileInfo(stlPath).size());
+
+        if (std::max(w, h) <= asciiLimit)
+        {
+            timer.start();
+            lithophane.saveToStl(stlPath, "ascii", true);
+            report.add(name, w, h, "ascii_stl", timer.nsecsElapsed(), triangles, QFileInfo(stlPath).size());
+        }
+        for (const QString format : {"3mf", "ply", "obj"})
+        {
+            const QString formatPath = tempDir.filePath("benchmark." + format);
+            timer.start();
+            lithophane.saveToStl(formatPath, format, true);
+            report.add(name, w, h, format, timer.nsecsElapsed(), triangles, QFileInfo(formatPath).size());
+            QFile::remove(formatPath);
+        }
+        QFile::remove(stlPath);
+
+        timer.start();
+        const IndexedVertexData previewData = lithophane.getMesh().indexedVertexData();
+        report.add(name, w, h, "preview_pack", timer.nsecsElapsed(), triangles, previewData.vertices.size() + previewData.indices.size());
+
+        // A live preview after moving the width slider, with the default maximum of preview triangles
+        lithophane.configure(image, 210.0f, 4.0f, 0.8f, 3.0f, 0.75f, false, 0.15f, 60.0f, 2);
+        timer.start();
+        lithophane.generatePreview(1000000);
+        const IndexedVertexData liveData = lithophane.takePreviewBuffer();
+        report.add(name, w, h, "live_preview", timer.nsecsElapsed(), liveData.indices.size() / (3 * sizeof(uint32_t)), liveData.vertices.size() + liveData.indices.size());
+    }
+
+    // The sphere the render used to add on top of the lithophane
+    Lithophane sphere;
+    timer.start();
+    sphere.uv_sphere(1000, 1000);
+    report.add("uv_sphere(1000, 1000)", 1000, 1000, "uv_sphere", timer.nsecsElapsed(), sphere.getMesh().triangleCount());
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+TEMPLATE = app
+TARGET = lithomaker-benchmark
+DEPENDPATH += . ../src
+INCLUDEPATH += . ../src
+CONFIG += console release c++17
+CONFIG -= app_bundle
+QT += gui concurrent
+QMAKE_CXX = clang++
+QMAKE_LINK = clang++
+# No code checks errno or floating point traps after math calls, and without
+# them the compiler can vectorize loops with square roots and divisions
+QMAKE_CXXFLAGS += -fno-math-errno -fno-trapping-math
+LIBS += -lz
+win32:LIBS += -lpsapi
+
+# Input
+HEADERS += ../src/lithophane.h \
+           ../src/mesh.h \
+           ../src/vertexcache.h \
+           ../src/decimator.h \
+           ../src/boundedqueue.h \
+           ../src/pipelinewriter.h \
+           ../src/atomicfile.h \
+           ../src/progressreporter.h \
+           ../src/chunkwriter.h \
+           ../src/stlwriter.h \
+           ../src/stlreader.h \
+           ../src/zipwriter.h \
+           ../src/threemfwriter.h \
+           ../src/plywriter.h \
+           ../src/objwriter.h \
+           ../src/heightfield.h \
+           ../src/imagetiles.h
+
+SOURCES += benchmark.cpp \
+           ../src/lithophane.cpp \
+           ../src/mesh.cpp \
+           ../src/vertexcache.cpp \
+           ../src/decimator.cpp \
+           ../src/stlwriter.cpp \
+           ../src/stlreader.cpp \
+           ../src/pipelinewriter.cpp \
+           ../src/atomicfile.cpp \
+           ../src/progressreporter.cpp \
+           ../src/zipwriter.cpp \
+           ../src/threemfwriter.cpp \
+           ../src/plywriter.cpp \
+           ../src/objwriter.cpp \
+           ../src/heightfield.cpp \
+           ../src/imagetiles.cpp
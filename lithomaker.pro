@@ -5,12 +5,14 @@ INCLUDEPATH += .
 CONFIG += debug c++17
 RESOURCES += lithomaker.qrc
 RC_FILE = lithomaker.rc
-QT += gui widgets 3dcore 3dextras
+QT += gui widgets concurrent 3dcore 3dextras
 TRANSLATIONS = lithomaker_da_DK.ts
 QMAKE_CXX = clang++
 QMAKE_LINK = clang++
-QMAKE_CXXFLAGS +=
-LIBS +=
+# No code checks errno or floating point traps after math calls, and without
+# them the compiler can vectorize loops with square roots and divisions
+QMAKE_CXXFLAGS += -fno-math-errno -fno-trapping-math
+LIBS += -lz
 
 include(./VERSION)
 DEFINES+=VERSION=\\\"$$VERSION\\\"
@@ -25,6 +27,22 @@ HEADERS += src/mainwindow.h \
            src/configdialog.h \
            src/aboutbox.h \
            src/lithophane.h \
+           src/mesh.h \
+           src/vertexcache.h \
+           src/decimator.h \
+           src/boundedqueue.h \
+           src/pipelinewriter.h \
+           src/atomicfile.h \
+           src/progressreporter.h \
+           src/chunkwriter.h \
+           src/stlwriter.h \
+           src/stlreader.h \
+           src/zipwriter.h \
+           src/threemfwriter.h \
+           src/plywriter.h \
+           src/objwriter.h \
+           src/heightfield.h \
+           src/imagetiles.h \
            src/preview.h
 
 SOURCES += src/main.cpp \
@@ -37,4 +55,18 @@ SOURCES += src/main.cpp \
            src/configdialog.cpp \
            src/aboutbox.cpp \
            src/lithophane.cpp \
+           src/mesh.cpp \
+           src/vertexcache.cpp \
+           src/decimator.cpp \
+           src/stlwriter.cpp \
+           src/stlreader.cpp \
+           src/pipelinewriter.cpp \
+           src/atomicfile.cpp \
+           src/progressreporter.cpp \
+           src/zipwriter.cpp \
+           src/threemfwriter.cpp \
+           src/plywriter.cpp \
+           src/objwriter.cpp \
+           src/heightfield.cpp \
+           src/imagetiles.cpp \
            src/preview.cpp
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 150 core
+
+in vec3 worldPosition;
+in vec3 worldNormal;
+
+out vec4 fragColor;
+
+// Lit like the other meshes of the preview by QDiffuseSpecularMaterial,
+// without the barely visible specular part
+uniform vec4 ambient;
+uniform vec4 diffuse;
+uniform vec3 lightPosition;
+uniform float lightIntensity;
+
+void main()
+{
+    vec3 n = normalize(worldNormal);
+    vec3 s = normalize(lightPosition - worldPosition);
+    float lambert = lightIntensity * max(dot(s, n), 0.0);
+    fragColor = vec4(ambient.rgb + diffuse.rgb * lambert, 1.0);
+}
@@ -0,0 +1,54 @@
+#version 150 core
+
+// Image pixel from the bottom left in xy, and in z the kind of vertex:
+// 0 on the image surface, 1 on top of a side wall, 2 at the backside
+in vec3 vertexPosition;
+// Side walls and backside only, the surface gets its normal from the heightmap
+in vec3 vertexNormal;
+
+out vec3 worldPosition;
+out vec3 worldNormal;
+
+uniform mat4 modelMatrix;
+uniform mat3 modelNormalMatrix;
+uniform mat4 modelViewProjection;
+
+// Grayscale input image, top row first
+uniform sampler2D heightmap;
+// Size of the input image in pixels
+uniform vec2 imageSize;
+// Same as in Lithophane, in mm
+uniform float pixelSize;
+uniform float frameBorder;
+uniform float width;
+uniform float depth;
+uniform float minThickness;
+
+// Thickness above the minimum thickness, like Heightfield
+float thickness(vec2 pixel)
+{
+    vec2 uv = vec2((pixel.x + 0.5) / imageSize.x, (imageSize.y - 0.5 - pixel.y) / imageSize.y);
+    return (1.0 - textureLod(heightmap, uv, 0.0).r) * depth;
+}
+
+void main()
+{
+    vec2 pixel = vertexPosition.xy;
+    vec3 position = vec3(pixel * pixelSize + vec2(frameBorder - width / 2.0, frameBorder), -minThickness);
+    vec3 normal = vertexNormal;
+    if (vertexPosition.z < 1.5)
+    {
+        position.z = thickness(pixel);
+    }
+    if (vertexPosition.z < 0.5)
+    {
+        // Central differences over the neighbouring pixels
+        float dx = thickness(pixel + vec2(1.0, 0.0)) - thickness(pixel - vec2(1.0, 0.0));
+        float dy = thickness(pixel + vec2(0.0, 1.0)) - thickness(pixel - vec2(0.0, 1.0));
+        normal = normalize(vec3(-dx, -dy, 2.0 * pixelSize));
+    }
+
+    worldPosition = vec3(modelMatrix * vec4(position, 1.0));
+    worldNormal = normalize(modelNormalMatrix * normal);
+    gl_Position = modelViewProjection * vec4(position, 1.0);
+}
@@ -0,0 +1,97 @@
+#include "atomicfile.h"
+
+#include <atomic>
+#include <cstdio>
+#if defined(Q_OS_WIN)
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+
+namespace {
+
+bool syncToDisk(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite)) return false;
+#if defined(Q_OS_WIN)
+    return _commit(file.handle()) == 0;
+#else
+    return fsync(file.handle()) == 0;
+#endif
+}
+
+// The replacement keeps the mode of the file it replaces, and its owner and
+// group as far as the user may set them
+void copyPermissions(const QString& from, const QString& to)
+{
+    if (!QFile::exists(from)) return;
+    QFile::setPermissions(to, QFile::permissions(from));
+#if !defined(Q_OS_WIN)
+    struct stat status;
+    if (stat(QFile::encodeName(from).constData(), &status) == 0)
+    {
+        if (chown(QFile::encodeName(to).constData(), status.st_uid, status.st_gid) != 0)
+        {
+            // Only the group may be up to the user
+            (void) chown(QFile::encodeName(to).constData(), (uid_t) -1, status.st_gid);
+        }
+    }
+#endif
+}
+
+bool replaceFile(const QString& from, const QString& to)
+{
+#if defined(Q_OS_WIN)
+    return MoveFileExW(
+        (const wchar_t*)QDir::toNativeSeparators(from).utf16(), (const wchar_t*)QDir::toNativeSeparators(to).utf16(),
+        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH
+    );
+#else
+    if (rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) != 0) return false;
+
+    // The new directory entry has to reach the disk as well
+    const int directory = open(QFile::encodeName(QFileInfo(to).absolutePath()).constData(), O_RDONLY);
+    if (directory >= 0)
+    {
+        fsync(directory);
+        close(directory);
+    }
+    return true;
+#endif
+}
+
+}
+
+QString createTemporaryFile(const QString& path)
+{
+    static std::atomic<int> counter{0};
+
+    // Hidden and numbered, skipping names left behind by an earlier crash
+    const QFileInfo info(path);
+    for (int attempt = 0; attempt < 100; ++attempt)
+    {
+        const QString name = info.absoluteDir().filePath(QString(".%1.%2.part").arg(info.fileName()).arg(counter++));
+        QFile file(name);
+        if (file.open(QIODevice::WriteOnly | QIODevice::NewOnly)) return name;
+        if (!file.exists()) break;
+    }
+    return QString();
+}
+
+bool commitTemporaryFile(const QString& temporaryPath, const QString& path)
+{
+    copyPermissions(path, temporaryPath);
+    if (syncToDisk(temporaryPath) && replaceFile(temporaryPath, path)) return true;
+
+    QFile::remove(temporaryPath);
+    return false;
+}
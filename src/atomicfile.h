@@ -0,0 +1,21 @@
+#ifndef __ATOMICFILE_H__
+#define __ATOMICFILE_H__
+
+#include <QString>
+
+
+// Files are exported to a temporary file next to the destination, which is
+// renamed over it once complete and on disk. A crash or a full disk then
+// never leaves a truncated file behind, and the previous version stays in
+// place until the new one is whole.
+
+// Creates a new, empty temporary file in the directory of 'path' and returns
+// its name, or an empty string if the directory isn't writable
+QString createTemporaryFile(const QString& path);
+
+// Flushes 'temporaryPath' to disk and renames it to 'path', replacing any
+// file there in one step. The replaced file's permissions carry over. The
+// temporary file is removed if that fails.
+bool commitTemporaryFile(const QString& temporaryPath, const QString& path);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef __BOUNDEDQUEUE_H__
+#define __BOUNDEDQUEUE_H__
+
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+
+// Hands items from producer threads to a consumer thread. push() blocks while
+// the queue is full, so a fast producer cannot run ahead of a slow consumer
+// by more than 'capacity' items.
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity) : m_Capacity(capacity) {}
+
+    void push(T item)
+    {
+        QMutexLocker locker(&m_Mutex);
+        while (m_Items.count() >= m_Capacity && !m_Closed) m_NotFull.wait(&m_Mutex);
+        if (m_Closed) return;
+        m_Items.enqueue(std::move(item));
+        m_NotEmpty.wakeOne();
+    }
+
+    // Blocks until an item is available. Returns false once the queue is closed
+    // and all queued items have been taken.
+    bool pop(T& item)
+    {
+        QMutexLocker locker(&m_Mutex);
+        while (m_Items.isEmpty() && !m_Closed) m_NotEmpty.wait(&m_Mutex);
+        if (m_Items.isEmpty()) return false;
+        item = m_Items.dequeue();
+        m_NotFull.wakeOne();
+        return true;
+    }
+
+    // No more items will be pushed. Items pushed after closing are dropped.
+    void close()
+    {
+        QMutexLocker locker(&m_Mutex);
+        m_Closed = true;
+        m_NotEmpty.wakeAll();
+        m_NotFull.wakeAll();
+    }
+
+private:
+    const int m_Capacity;
+    bool m_Closed = false;
+    QQueue<T> m_Items;
+    QMutex m_Mutex;
+    QWaitCondition m_NotEmpty, m_NotFull;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef __CHUNKWRITER_H__
+#define __CHUNKWRITER_H__
+
+#include <algorithm>
+#include <functional>
+
+#include <QByteArray>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+
+
+// Formats a long run of records, like the facets or vertices of a mesh, on all
+// cores. Chunks of records are formatted into a fixed set of buffers, which are
+// allocated once and reused, and handed to the output in order. Memory use
+// doesn't depend on the number of records and the output doesn't depend on the
+// number of threads.
+class ChunkWriter
+{
+public:
+    // No record is longer than 'maxRecordSize' bytes
+    explicit ChunkWriter(int maxRecordSize, int recordsPerChunk = 4096) :
+        m_RecordsPerChunk(recordsPerChunk),
+        m_Batch(std::max(1, QThreadPool::globalInstance()->maxThreadCount() * 4))
+    {
+        for (Chunk& chunk : m_Batch)
+        {
+            chunk.data.resize(recordsPerChunk * maxRecordSize);
+        }
+    }
+
+    // Formats records [0, count) with 'char* putRecord(char* out, int record)',
+    // which returns the end of what it wrote, and passes them on to
+    // 'bool output(const char* data, qint64 size)'. 'progress' gets the number
+    // of records done between batches. Returns false once 'output' fails.
+    template<typename PutRecord, typename Output>
+    bool write(int count, PutRecord putRecord, Output output, const std::function<void(int)>& progress = nullptr)
+    {
+        const auto formatChunk = [&putRecord](Chunk& chunk) {
+            char* start = chunk.data.data();
+            char* out = start;
+            for (int i = chunk.first; i < chunk.last; ++i)
+            {
+                out = putRecord(out, i);
+            }
+            chunk.size = out - start;
+        };
+
+        bool ok = true;
+        for (int first = 0; ok && first < count;)
+        {
+            int used = 0;
+            for (; used < m_Batch.count() && first < count; ++used, first += m_RecordsPerChunk)
+            {
+                m_Batch[used].first = first;
+                m_Batch[used].last = std::min(first + m_RecordsPerChunk, count);
+            }
+            QtConcurrent::blockingMap(m_Batch.begin(), m_Batch.begin() + used, formatChunk);
+
+            for (int i = 0; ok && i < used; ++i)
+            {
+                ok = output(m_Batch.at(i).data.constData(), m_Batch.at(i).size);
+            }
+            if (progress) progress(m_Batch.at(used - 1).last);
+        }
+        return ok;
+    }
+
+private:
+    // Records [first, last), taking up 'size' bytes of 'data'
+    struct Chunk
+    {
+        int first, last;
+        QByteArray data;
+        qint64 size;
+    };
+
+    int m_RecordsPerChunk;
+    QVector<Chunk> m_Batch;
+};
+
+#endif
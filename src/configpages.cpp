@@ -73,6 +73,48 @@ RenderPage::RenderPage(QWidget *parent) : QWidget(parent)
   Slider *hangersSlider = new Slider("render", "hangers", 1, 4, 2, 1);
   connect(resetButton, &QPushButton::clicked, hangersSlider, &Slider::resetToDefault);
 
+  CheckBox *adaptiveMeshingCheckBox = new CheckBox("render", "adaptiveMeshing", tr("Merge flat image areas into larger triangles"), false);
+  connect(resetButton, &QPushButton::clicked, adaptiveMeshingCheckBox, &CheckBox::resetToDefault);
+
+  QLabel *meshToleranceLabel = new QLabel(tr("Maximum thickness deviation when merging (mm):"));
+  LineEdit *meshToleranceLineEdit = new LineEdit("render", "meshTolerance", "0.05");
+  connect(resetButton, &QPushButton::clicked, meshToleranceLineEdit, &LineEdit::resetToDefault);
+
+  CheckBox *decimateCheckBox = new CheckBox("render", "decimate", tr("Reduce the number of triangles after rendering"), false);
+  connect(resetButton, &QPushButton::clicked, decimateCheckBox, &CheckBox::resetToDefault);
+
+  QLabel *decimateTargetLabel = new QLabel(tr("Target number of triangles:"));
+  LineEdit *decimateTargetLineEdit = new LineEdit("render", "decimateTarget", "500000");
+  connect(resetButton, &QPushButton::clicked, decimateTargetLineEdit, &LineEdit::resetToDefault);
+
+  QLabel *decimateMaxErrorLabel = new QLabel(tr("Maximum deviation when reducing (mm):"));
+  LineEdit *decimateMaxErrorLineEdit = new LineEdit("render", "decimateMaxError", "0.05");
+  connect(resetButton, &QPushButton::clicked, decimateMaxErrorLineEdit, &LineEdit::resetToDefault);
+
+  CheckBox *limitSizeCheckBox = new CheckBox("render", "limitSize", tr("Scale down large input images"), true);
+  connect(resetButton, &QPushButton::clicked, limitSizeCheckBox, &CheckBox::resetToDefault);
+
+  QLabel *maxSizeLabel = new QLabel(tr("Maximum image width and height (pixels):"));
+  LineEdit *maxSizeLineEdit = new LineEdit("render", "maxSize", "1000");
+  connect(resetButton, &QPushButton::clicked, maxSizeLineEdit, &LineEdit::resetToDefault);
+
+  QLabel *previewTrianglesLabel = new QLabel(tr("Maximum number of triangles shown in the preview:"));
+  LineEdit *previewTrianglesLineEdit = new LineEdit("render", "previewTriangles", "1000000");
+  connect(resetButton, &QPushButton::clicked, previewTrianglesLineEdit, &LineEdit::resetToDefault);
+
+  CheckBox *gpuPreviewCheckBox = new CheckBox("render", "gpuPreview", tr("Draw the image on the graphics card for instant slider changes"), false);
+  connect(resetButton, &QPushButton::clicked, gpuPreviewCheckBox, &CheckBox::resetToDefault);
+
+  CheckBox *liveRenderCheckBox = new CheckBox("render", "liveRender", tr("Render again while the sliders are moved"), false);
+  connect(resetButton, &QPushButton::clicked, liveRenderCheckBox, &CheckBox::resetToDefault);
+
+  QLabel *liveRenderBudgetLabel = new QLabel(tr("Time allowed for each live preview (ms):"));
+  LineEdit *liveRenderBudgetLineEdit = new LineEdit("render", "liveRenderBudget", "100");
+  connect(resetButton, &QPushButton::clicked, liveRenderBudgetLineEdit, &LineEdit::resetToDefault);
+
+  CheckBox *previewStatsCheckBox = new CheckBox("render", "previewStats", tr("Show frame time, triangle count and buffer size above the preview"), false);
+  connect(resetButton, &QPushButton::clicked, previewStatsCheckBox, &CheckBox::resetToDefault);
+
   QVBoxLayout *layout = new QVBoxLayout();
   layout->addWidget(resetButton);
   layout->addWidget(enableStabilizersCheckBox);
@@ -86,6 +128,24 @@ RenderPage::RenderPage(QWidget *parent) : QWidget(parent)
   layout->addWidget(enableHangersCheckBox);
   layout->addWidget(hangersLabel);
   layout->addWidget(hangersSlider);
+  layout->addWidget(adaptiveMeshingCheckBox);
+  layout->addWidget(meshToleranceLabel);
+  layout->addWidget(meshToleranceLineEdit);
+  layout->addWidget(decimateCheckBox);
+  layout->addWidget(decimateTargetLabel);
+  layout->addWidget(decimateTargetLineEdit);
+  layout->addWidget(decimateMaxErrorLabel);
+  layout->addWidget(decimateMaxErrorLineEdit);
+  layout->addWidget(limitSizeCheckBox);
+  layout->addWidget(maxSizeLabel);
+  layout->addWidget(maxSizeLineEdit);
+  layout->addWidget(previewTrianglesLabel);
+  layout->addWidget(previewTrianglesLineEdit);
+  layout->addWidget(gpuPreviewCheckBox);
+  layout->addWidget(liveRenderCheckBox);
+  layout->addWidget(liveRenderBudgetLabel);
+  layout->addWidget(liveRenderBudgetLineEdit);
+  layout->addWidget(previewStatsCheckBox);
   layout->addStretch();
   setLayout(layout);
 }
@@ -94,15 +154,27 @@ ExportPage::ExportPage(QWidget *parent) : QWidget(parent)
 {
   QPushButton *resetButton = new QPushButton(tr("Reset all to defaults"));
 
-  QLabel *stlFormatLabel = new QLabel(tr("STL format:"));
+  QLabel *stlFormatLabel = new QLabel(tr("Export format:"));
   ComboBox *stlFormatComboBox = new ComboBox("export", "stlFormat", "binary");
   stlFormatComboBox->addConfigItem("Ascii", "ascii");
   stlFormatComboBox->addConfigItem("Binary", "binary");
+  stlFormatComboBox->addConfigItem("3MF", "3mf");
+  stlFormatComboBox->addConfigItem("PLY (binary)", "ply");
+  stlFormatComboBox->addConfigItem("OBJ", "obj");
   stlFormatComboBox->setFromConfig();
   connect(resetButton, &QPushButton::clicked, stlFormatComboBox, &ComboBox::resetToDefault);
 
+  CheckBox *compressCheckBox = new CheckBox("export", "compress", tr("Compress STL files with gzip (.stl.gz)"), false);
+  connect(resetButton, &QPushButton::clicked, compressCheckBox, &CheckBox::resetToDefault);
+
   CheckBox *alwaysOverwriteCheckBox = new CheckBox("export", "alwaysOverwrite", tr("Always overwrite existing file"), false);
   connect(resetButton, &QPushButton::clicked, alwaysOverwriteCheckBox, &CheckBox::resetToDefault);
+
+  CheckBox *streamingCheckBox = new CheckBox("export", "streaming", tr("Generate binary STL directly from the image (low memory, no render needed)"), false);
+  connect(resetButton, &QPushButton::clicked, streamingCheckBox, &CheckBox::resetToDefault);
+
+  CheckBox *embedPrintSettingsCheckBox = new CheckBox("export", "embedPrintSettings", tr("Include the lithophane optimized PrusaSlicer print settings in 3MF files"), true);
+  connect(resetButton, &QPushButton::clicked, embedPrintSettingsCheckBox, &CheckBox::resetToDefault);
   /*
   QLabel *delimiterLabel = new QLabel(tr("Delimiter:"));
   ComboBox *delimiterComboBox = new ComboBox("Export", "delimiter", "tab");
@@ -125,7 +197,10 @@ ExportPage::ExportPage(QWidget *parent) : QWidget(parent)
   layout->addWidget(resetButton);
   layout->addWidget(stlFormatLabel);
   layout->addWidget(stlFormatComboBox);
+  layout->addWidget(compressCheckBox);
   layout->addWidget(alwaysOverwriteCheckBox);
+  layout->addWidget(streamingCheckBox);
+  layout->addWidget(embedPrintSettingsCheckBox);
   /*
   layout->addWidget(delimiterLabel);
   layout->addWidget(delimiterComboBox);
@@ -0,0 +1,394 @@
+#include "decimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <QtConcurrent>
+
+
+namespace {
+
+// Splits [0, count) into ranges of 'chunkSize' for QtConcurrent::blockingMap
+QVector<std::pair<int, int>> chunks(int count, int chunkSize)
+{
+    QVector<std::pair<int, int>> ranges;
+    for (int first = 0; first < count; first += chunkSize)
+    {
+        ranges.append({first, std::min(first + chunkSize, count)});
+    }
+    return ranges;
+}
+
+}
+
+void Decimator::Quadric::addPlane(const QVector3D& normal, double d)
+{
+    const double x = normal.x(), y = normal.y(), z = normal.z();
+    a[0] += x * x; a[1] += x * y; a[2] += x * z; a[3] += x * d;
+    a[4] += y * y; a[5] += y * z; a[6] += y * d;
+    a[7] += z * z; a[8] += z * d;
+    a[9] += d * d;
+}
+
+Decimator::Quadric& Decimator::Quadric::operator+=(const Quadric& other)
+{
+    for (int i = 0; i < 10; ++i) a[i] += other.a[i];
+    return *this;
+}
+
+double Decimator::Quadric::error(const QVector3D& v) const
+{
+    const double x = v.x(), y = v.y(), z = v.z();
+    return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+         + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+         + a[7] * z * z + 2 * a[8] * z
+         + a[9];
+}
+
+bool Decimator::Quadric::optimum(QVector3D& v) const
+{
+    // Solve the 3x3 system grad(error) = 0 with Cramer's rule
+    const double det = a[0] * (a[4] * a[7] - a[5] * a[5])
+                     - a[1] * (a[1] * a[7] - a[5] * a[2])
+                     + a[2] * (a[1] * a[5] - a[4] * a[2]);
+    if (std::fabs(det) < 1e-10) return false;
+
+    const double bx = -a[3], by = -a[6], bz = -a[8];
+    const double x = (bx * (a[4] * a[7] - a[5] * a[5]) - a[1] * (by * a[7] - a[5] * bz) + a[2] * (by * a[5] - a[4] * bz)) / det;
+    const double y = (a[0] * (by * a[7] - bz * a[5]) - bx * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * bz - by * a[2])) / det;
+    const double z = (a[0] * (a[4] * bz - a[5] * by) - a[1] * (a[1] * bz - by * a[2]) + bx * (a[1] * a[5] - a[4] * a[2])) / det;
+    v = QVector3D(x, y, z);
+    return true;
+}
+
+void Decimator::run(int targetTriangles, float maxError, const std::function<void(int)>& progress,
+                    const std::function<bool()>& canceled)
+{
+    const int initialTriangles = m_Mesh.triangleCount();
+    if (initialTriangles <= targetTriangles) return;
+
+    if (progress) progress(0);
+
+    m_Locked.resize(m_Mesh.vertexCount());
+    buildAdjacency();
+    lockOpenEdges();
+    computeQuadrics();
+    m_Mesh.normals.clear(); // Collapses move vertices and drop triangles
+
+    const double maxCost = maxError > 0 ? (double) maxError * maxError : std::numeric_limits<double>::max();
+    int noOfTriangles = initialTriangles;
+
+    while (noOfTriangles > targetTriangles)
+    {
+        if (canceled && canceled()) break;
+
+        // Cheapest collapse of every edge. Each interior edge shows up in two
+        // triangles, but only one of them lists it with the lower index first.
+        const int noOfFaces = m_Mesh.triangleCount();
+        QVector<Collapse> collapses(noOfFaces * 3);
+        QVector<std::pair<int, int>> faceRanges = chunks(noOfFaces, 4096);
+        QtConcurrent::blockingMap(faceRanges, [this, &collapses](const std::pair<int, int>& range) {
+            const uint32_t *indices = m_Mesh.indices.constData();
+            for (int f = range.first; f < range.second; ++f)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    const uint32_t a = indices[f * 3 + k], b = indices[f * 3 + (k + 1) % 3];
+                    Collapse &collapse = collapses[f * 3 + k];
+                    if (a >= b || !evaluate(a, b, collapse)) collapse.cost = -1.0;
+                }
+            }
+        });
+
+        QVector<Collapse> candidates;
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.cost >= 0.0 && collapse.cost <= maxCost) candidates.append(collapse);
+        }
+        collapses.clear();
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& c1, const Collapse& c2) {
+            if (c1.cost != c2.cost) return c1.cost < c2.cost;
+            return c1.keep != c2.keep ? c1.keep < c2.keep : c1.remove < c2.remove;
+        });
+
+        // Apply collapses cheapest first, skipping any that touch a neighbourhood
+        // already changed in this pass
+        QVector<uint8_t> touched(m_Mesh.vertexCount(), 0);
+        m_Dead.fill(0, noOfFaces);
+        int applied = 0;
+        for (const Collapse& collapse : candidates)
+        {
+            if (touched[collapse.keep] || touched[collapse.remove]) continue;
+            if (!isValid(collapse)) continue;
+
+            noOfTriangles -= apply(collapse, touched);
+            ++applied;
+            if (noOfTriangles <= targetTriangles) break;
+        }
+        if (applied == 0) break;
+
+        compact();
+        buildAdjacency();
+
+        if (progress)
+        {
+            progress((int)((float)(initialTriangles - noOfTriangles) / (float)(initialTriangles - targetTriangles) * 100.0f));
+        }
+    }
+
+    // Drop the vertices no triangle refers to anymore
+    QVector<uint32_t> remap(m_Mesh.vertexCount(), std::numeric_limits<uint32_t>::max());
+    QVector<QVector3D> vertices;
+    for (uint32_t &index : m_Mesh.indices)
+    {
+        if (remap[index] == std::numeric_limits<uint32_t>::max())
+        {
+            remap[index] = vertices.count();
+            vertices.append(m_Mesh.vertices.at(index));
+        }
+        index = remap[index];
+    }
+    m_Mesh.vertices = vertices;
+
+    if (progress) progress(100);
+}
+
+void Decimator::buildAdjacency()
+{
+    const int noOfVertices = m_Mesh.vertexCount();
+    const uint32_t *indices = m_Mesh.indices.constData();
+    const int noOfCorners = m_Mesh.indices.count();
+
+    m_FaceStart.fill(0, noOfVertices + 1);
+    for (int c = 0; c < noOfCorners; ++c) ++m_FaceStart[indices[c] + 1];
+    for (int v = 0; v < noOfVertices; ++v) m_FaceStart[v + 1] += m_FaceStart[v];
+
+    QVector<uint32_t> fill = m_FaceStart;
+    m_Faces.resize(noOfCorners);
+    for (int c = 0; c < noOfCorners; ++c) m_Faces[fill[indices[c]]++] = c / 3;
+}
+
+void Decimator::lockOpenEdges()
+{
+    // An edge is closed when exactly one triangle runs along it in each direction.
+    // Each vertex only checks and locks itself, so vertices can run in parallel.
+    QVector<std::pair<int, int>> vertexRanges = chunks(m_Mesh.vertexCount(), 4096);
+    QtConcurrent::blockingMap(vertexRanges, [this](const std::pair<int, int>& range) {
+        const uint32_t *indices = m_Mesh.indices.constData();
+        auto countEdges = [this, indices](uint32_t from, uint32_t to) {
+            int count = 0;
+            for (uint32_t i = m_FaceStart[from]; i < m_FaceStart[from + 1]; ++i)
+            {
+                const uint32_t *face = indices + m_Faces[i] * 3;
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (face[k] == from && face[(k + 1) % 3] == to) ++count;
+                }
+            }
+            return count;
+        };
+
+        for (int v = range.first; v < range.second; ++v)
+        {
+            for (uint32_t i = m_FaceStart[v]; i < m_FaceStart[v + 1] && !m_Locked[v]; ++i)
+            {
+                const uint32_t *face = indices + m_Faces[i] * 3;
+                const int k = face[0] == (uint32_t) v ? 0 : (face[1] == (uint32_t) v ? 1 : 2);
+                const uint32_t next = face[(k + 1) % 3], previous = face[(k + 2) % 3];
+                if (countEdges(v, next) != 1 || countEdges(next, v) != 1 ||
+                    countEdges(previous, v) != 1 || countEdges(v, previous) != 1)
+                {
+                    m_Locked[v] = 1;
+                }
+            }
+        }
+    });
+}
+
+void Decimator::computeQuadrics()
+{
+    const int noOfFaces = m_Mesh.triangleCount();
+    QVector<Quadric> faceQuadrics(noOfFaces);
+    QVector<std::pair<int, int>> faceRanges = chunks(noOfFaces, 4096);
+    QtConcurrent::blockingMap(faceRanges, [this, &faceQuadrics](const std::pair<int, int>& range) {
+        for (int f = range.first; f < range.second; ++f)
+        {
+            const QVector3D &v1 = m_Mesh.vertex(f, 0);
+            const QVector3D normal = m_Mesh.normal(f);
+            if (!normal.isNull()) faceQuadrics[f].addPlane(normal, -QVector3D::dotProduct(normal, v1));
+        }
+    });
+
+    m_Quadrics.resize(m_Mesh.vertexCount());
+    QVector<std::pair<int, int>> vertexRanges = chunks(m_Mesh.vertexCount(), 4096);
+    QtConcurrent::blockingMap(vertexRanges, [this, &faceQuadrics](const std::pair<int, int>& range) {
+        for (int v = range.first; v < range.second; ++v)
+        {
+            for (uint32_t i = m_FaceStart[v]; i < m_FaceStart[v + 1]; ++i)
+            {
+                m_Quadrics[v] += faceQuadrics.at(m_Faces[i]);
+            }
+        }
+    });
+}
+
+bool Decimator::evaluate(uint32_t a, uint32_t b, Collapse& collapse) const
+{
+    if (m_Locked[a] && m_Locked[b]) return false;
+
+    Quadric quadric = m_Quadrics.at(a);
+    quadric += m_Quadrics.at(b);
+
+    const QVector3D &pa = m_Mesh.vertices.at(a), &pb = m_Mesh.vertices.at(b);
+    if (m_Locked[a] || m_Locked[b])
+    {
+        collapse.keep = m_Locked[a] ? a : b;
+        collapse.remove = m_Locked[a] ? b : a;
+        collapse.position = m_Mesh.vertices.at(collapse.keep);
+        collapse.cost = std::max(0.0, quadric.error(collapse.position));
+        return true;
+    }
+
+    collapse.keep = a;
+    collapse.remove = b;
+
+    // Use the optimal position unless it lies far off the edge (nearly flat areas),
+    // otherwise the best of the end points and the midpoint
+    const QVector3D midpoint = (pa + pb) * 0.5f;
+    QVector3D position;
+    if (quadric.optimum(position) && (position - midpoint).length() <= (pb - pa).length())
+    {
+        collapse.position = position;
+        collapse.cost = quadric.error(position);
+    }
+    else
+    {
+        collapse.position = pa;
+        collapse.cost = quadric.error(pa);
+        for (const QVector3D& p : {pb, midpoint})
+        {
+            const double cost = quadric.error(p);
+            if (cost < collapse.cost)
+            {
+                collapse.position = p;
+                collapse.cost = cost;
+            }
+        }
+    }
+    collapse.cost = std::max(0.0, collapse.cost);
+    return true;
+}
+
+bool Decimator::isValid(const Collapse& collapse) const
+{
+    const uint32_t keep = collapse.keep, remove = collapse.remove;
+    const uint32_t *indices = m_Mesh.indices.constData();
+
+    // Link condition: the only vertices both end points share must be the tips of
+    // the two triangles along the edge, otherwise the collapse pinches the surface
+    QVector<uint32_t> keepNeighbours, removeNeighbours, tips;
+    for (uint32_t i = m_FaceStart[keep]; i < m_FaceStart[keep + 1]; ++i)
+    {
+        const uint32_t *face = indices + m_Faces[i] * 3;
+        const bool shared = face[0] == remove || face[1] == remove || face[2] == remove;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (face[k] == keep || face[k] == remove) continue;
+            keepNeighbours.append(face[k]);
+            if (shared) tips.append(face[k]);
+        }
+    }
+    if (tips.count() != 2 || tips[0] == tips[1]) return false;
+
+    for (uint32_t i = m_FaceStart[remove]; i < m_FaceStart[remove + 1]; ++i)
+    {
+        const uint32_t *face = indices + m_Faces[i] * 3;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (face[k] != keep && face[k] != remove) removeNeighbours.append(face[k]);
+        }
+    }
+    std::sort(keepNeighbours.begin(), keepNeighbours.end());
+    keepNeighbours.erase(std::unique(keepNeighbours.begin(), keepNeighbours.end()), keepNeighbours.end());
+    std::sort(removeNeighbours.begin(), removeNeighbours.end());
+    removeNeighbours.erase(std::unique(removeNeighbours.begin(), removeNeighbours.end()), removeNeighbours.end());
+
+    int noOfShared = 0;
+    for (uint32_t v : removeNeighbours)
+    {
+        if (std::binary_search(keepNeighbours.begin(), keepNeighbours.end(), v)) ++noOfShared;
+    }
+    if (noOfShared != 2) return false;
+
+    // The remaining triangles around both end points must not flip or degenerate
+    for (uint32_t vertex : {keep, remove})
+    {
+        for (uint32_t i = m_FaceStart[vertex]; i < m_FaceStart[vertex + 1]; ++i)
+        {
+            const uint32_t *face = indices + m_Faces[i] * 3;
+            if ((face[0] == keep || face[1] == keep || face[2] == keep) &&
+                (face[0] == remove || face[1] == remove || face[2] == remove)) continue;
+
+            QVector3D p[3];
+            for (int k = 0; k < 3; ++k) p[k] = m_Mesh.vertices.at(face[k]);
+            const QVector3D before = QVector3D::crossProduct(p[1] - p[0], p[2] - p[0]);
+            for (int k = 0; k < 3; ++k)
+            {
+                if (face[k] == vertex) p[k] = collapse.position;
+            }
+            const QVector3D after = QVector3D::crossProduct(p[1] - p[0], p[2] - p[0]);
+            if (after.lengthSquared() <= 1e-12f || QVector3D::dotProduct(before, after) <= 0.0f) return false;
+        }
+    }
+    return true;
+}
+
+int Decimator::apply(const Collapse& collapse, QVector<uint8_t>& touched)
+{
+    const uint32_t keep = collapse.keep, remove = collapse.remove;
+    uint32_t *indices = m_Mesh.indices.data();
+
+    int removed = 0;
+    for (uint32_t vertex : {keep, remove})
+    {
+        for (uint32_t i = m_FaceStart[vertex]; i < m_FaceStart[vertex + 1]; ++i)
+        {
+            uint32_t *face = indices + m_Faces[i] * 3;
+            for (int k = 0; k < 3; ++k) touched[face[k]] = 1;
+        }
+    }
+    for (uint32_t i = m_FaceStart[remove]; i < m_FaceStart[remove + 1]; ++i)
+    {
+        const uint32_t f = m_Faces[i];
+        uint32_t *face = indices + f * 3;
+        if (face[0] == keep || face[1] == keep || face[2] == keep)
+        {
+            m_Dead[f] = 1;
+            ++removed;
+            continue;
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            if (face[k] == remove) face[k] = keep;
+        }
+    }
+
+    m_Mesh.vertices[keep] = collapse.position;
+    m_Quadrics[keep] += m_Quadrics.at(remove);
+    return removed;
+}
+
+void Decimator::compact()
+{
+    uint32_t *indices = m_Mesh.indices.data();
+    const int noOfFaces = m_Mesh.triangleCount();
+    int alive = 0;
+    for (int f = 0; f < noOfFaces; ++f)
+    {
+        if (m_Dead.at(f)) continue;
+        if (alive != f) std::copy(indices + f * 3, indices + f * 3 + 3, indices + alive * 3);
+        ++alive;
+    }
+    m_Mesh.indices.resize(alive * 3);
+}
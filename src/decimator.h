@@ -0,0 +1,69 @@
+#ifndef __DECIMATOR_H__
+#define __DECIMATOR_H__
+
+#include <cstdint>
+#include <functional>
+
+#include <QVector>
+#include <QVector3D>
+
+#include "mesh.h"
+
+
+// Quadric error metric edge collapse simplification (Garland & Heckbert).
+// Each pass evaluates all edge collapses in parallel and then applies the
+// cheapest ones whose neighbourhoods do not overlap.
+class Decimator
+{
+public:
+    explicit Decimator(Mesh& mesh) : m_Mesh(mesh) {}
+
+    // Vertices that must keep their position, on top of those on open or
+    // non-manifold edges, which are always kept
+    void setLocked(const QVector<uint8_t>& locked) { m_Locked = locked; }
+
+    // Collapses edges until the mesh has no more than 'targetTriangles' triangles,
+    // or until the next collapse would move the surface further than 'maxError'
+    // away from the original one (0 disables the limit). Progress is 0 - 100%.
+    // 'canceled' is polled between passes; a canceled run leaves a valid but
+    // only partly simplified mesh.
+    void run(int targetTriangles, float maxError, const std::function<void(int)>& progress = nullptr,
+             const std::function<bool()>& canceled = nullptr);
+
+private:
+    struct Quadric
+    {
+        double a[10] = {}; // Upper triangle of the symmetric 4x4 matrix, row by row
+
+        void addPlane(const QVector3D& normal, double d);
+        Quadric& operator+=(const Quadric& other);
+        double error(const QVector3D& v) const;
+        bool optimum(QVector3D& v) const;
+    };
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t keep, remove;
+        QVector3D position;
+    };
+
+    void computeQuadrics();
+    void buildAdjacency();
+    void lockOpenEdges();
+    bool evaluate(uint32_t a, uint32_t b, Collapse& collapse) const;
+    bool isValid(const Collapse& collapse) const;
+    int apply(const Collapse& collapse, QVector<uint8_t>& touched);
+    void compact();
+
+    Mesh& m_Mesh;
+    QVector<uint8_t> m_Locked;
+    QVector<Quadric> m_Quadrics;
+    QVector<uint8_t> m_Dead; // Per triangle
+
+    // Triangles around each vertex (compressed rows, rebuilt every pass)
+    QVector<uint32_t> m_FaceStart;
+    QVector<uint32_t> m_Faces;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "heightfield.h"
+
+#include <algorithm>
+
+#include <QColor>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HEIGHTFIELD_X86
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+typedef void (*ThicknessKernel)(const uchar* gray, float* out, int count, float scale);
+
+// out[i] = (255 - gray[i]) * scale
+void thicknessScalar(const uchar* gray, float* out, int count, float scale)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        out[i] = (255 - gray[i]) * scale;
+    }
+}
+
+#ifdef HEIGHTFIELD_X86
+__attribute__((target("sse2")))
+void thicknessSse2(const uchar* gray, float* out, int count, float scale)
+{
+    const __m128i ones = _mm_set1_epi8((char) 0xff);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 factor = _mm_set1_ps(scale);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        // 255 - g is a bitwise not on unsigned bytes
+        const __m128i g = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (gray + i)), ones);
+        const __m128i lo = _mm_unpacklo_epi8(g, zero);
+        const __m128i hi = _mm_unpackhi_epi8(g, zero);
+        _mm_storeu_ps(out + i,      _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), factor));
+        _mm_storeu_ps(out + i + 4,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), factor));
+        _mm_storeu_ps(out + i + 8,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), factor));
+        _mm_storeu_ps(out + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), factor));
+    }
+    thicknessScalar(gray + i, out + i, count - i, scale);
+}
+
+__attribute__((target("avx2")))
+void thicknessAvx2(const uchar* gray, float* out, int count, float scale)
+{
+    const __m128i ones = _mm_set1_epi8((char) 0xff);
+    const __m256 factor = _mm256_set1_ps(scale);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i g = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (gray + i)), ones);
+        const __m256i lo = _mm256_cvtepu8_epi32(g);
+        const __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(g, 8));
+        _mm256_storeu_ps(out + i,     _mm256_mul_ps(_mm256_cvtepi32_ps(lo), factor));
+        _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), factor));
+    }
+    thicknessScalar(gray + i, out + i, count - i, scale);
+}
+#endif
+
+ThicknessKernel selectKernel()
+{
+#ifdef HEIGHTFIELD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return thicknessAvx2;
+    if (__builtin_cpu_supports("sse2")) return thicknessSse2;
+#endif
+    return thicknessScalar;
+}
+
+const ThicknessKernel thicknessKernel = selectKernel();
+
+}
+
+void Heightfield::build(const QImage& image, float depth, int firstRow)
+{
+    // 32-bit images are converted to gray a row at a time below; anything more
+    // exotic (palettes, 16 bit channels, ...) goes through Qt once up front
+    const bool isRgb32 = image.format() == QImage::Format_RGB32 ||
+                         image.format() == QImage::Format_ARGB32 ||
+                         image.format() == QImage::Format_ARGB32_Premultiplied;
+    const QImage source = (image.format() == QImage::Format_Grayscale8 || isRgb32) ?
+        image : image.convertToFormat(QImage::Format_Grayscale8);
+
+    m_Width = source.width();
+    m_Height = source.height();
+    m_FirstRow = firstRow;
+    m_Data.resize(m_Width * m_Height);
+
+    const float scale = depth / 255.0f;
+    float *data = m_Data.data();
+
+    auto buildRows = [&](const std::pair<int, int>& rows) {
+        QVector<uchar> gray(isRgb32 ? m_Width : 0);
+        for (int y = rows.first; y < rows.second; ++y)
+        {
+            const uchar *line = source.constScanLine(m_Height - 1 - y);
+            if (isRgb32)
+            {
+                const QRgb *pixels = reinterpret_cast<const QRgb *>(line);
+                for (int x = 0; x < m_Width; ++x)
+                {
+                    gray[x] = qGray(pixels[x]);
+                }
+                line = gray.constData();
+            }
+            thicknessKernel(line, data + y * m_Width, m_Width, scale);
+        }
+    };
+
+    constexpr int rowsPerBand = 64;
+    QVector<std::pair<int, int>> bands;
+    for (int y = 0; y < m_Height; y += rowsPerBand)
+    {
+        bands.append({y, std::min(y + rowsPerBand, m_Height)});
+    }
+    QtConcurrent::blockingMap(bands, buildRows);
+}
+
+void Heightfield::clear()
+{
+    m_Width = m_Height = m_FirstRow = 0;
+    m_Data.clear();
+}
@@ -0,0 +1,34 @@
+#ifndef __HEIGHTFIELD_H__
+#define __HEIGHTFIELD_H__
+
+#include <QImage>
+#include <QVector>
+
+
+// Contiguous float grid of lithophane thicknesses above the minimum thickness,
+// one sample per image pixel. Rows are flipped so y = 0 is the bottom image row.
+// A heightfield may also hold just a strip of a larger grid, rows [firstRow(),
+// firstRow() + height()), which are still addressed by their row in the full grid.
+class Heightfield
+{
+public:
+    // Converts the image to grayscale and inverts it on the fly, so the darkest
+    // pixels map to 'depth' and the brightest to 0. The bottom image row
+    // becomes row 'firstRow'.
+    void build(const QImage& image, float depth, int firstRow = 0);
+    void clear();
+
+    int width() const { return m_Width; }
+    int height() const { return m_Height; }
+    int firstRow() const { return m_FirstRow; }
+    bool isEmpty() const { return m_Data.isEmpty(); }
+
+    float at(int x, int y) const { return m_Data[(y - m_FirstRow) * m_Width + x]; }
+    const float* row(int y) const { return m_Data.constData() + (y - m_FirstRow) * m_Width; }
+
+private:
+    int m_Width = 0, m_Height = 0, m_FirstRow = 0;
+    QVector<float> m_Data;
+};
+
+#endif
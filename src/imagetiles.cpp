@@ -0,0 +1,75 @@
+#include "imagetiles.h"
+
+#include <QFileInfo>
+#include <QImageReader>
+#include <QRect>
+
+
+ImageTiles::ImageTiles(const QImage& image) :
+    m_Size(image.size()),
+    m_Image(image)
+{
+}
+
+bool ImageTiles::open(const QString& path, int maxSize)
+{
+    m_Path = path;
+    m_Modified = QFileInfo(path).lastModified();
+    m_Image = QImage();
+
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    m_Size = reader.size();
+    if (!m_Size.isValid()) return false;
+    if (reader.transformation() & QImageIOHandler::TransformationRotate90) m_Size.transpose();
+
+    m_Scaled = maxSize > 0 && (m_Size.width() > maxSize || m_Size.height() > maxSize);
+    if (m_Scaled) m_Size.scale(maxSize, maxSize, Qt::KeepAspectRatio);
+
+    // Clip rectangles apply before the EXIF orientation, so rotated images and
+    // readers that would only emulate clipping on a fully decoded image are read once
+    const bool clipsNatively = m_Scaled ?
+        reader.supportsOption(QImageIOHandler::ScaledSize) && reader.supportsOption(QImageIOHandler::ScaledClipRect) :
+        reader.supportsOption(QImageIOHandler::ClipRect);
+    m_Clipped = clipsNatively && reader.transformation() == QImageIOHandler::TransformationNone;
+    return true;
+}
+
+QImage ImageTiles::read(int top, int rows) const
+{
+    if (m_Clipped)
+    {
+        const QRect clip(0, top, m_Size.width(), rows);
+        QImageReader reader(m_Path);
+        if (m_Scaled)
+        {
+            reader.setScaledSize(m_Size);
+            reader.setScaledClipRect(clip);
+        }
+        else
+        {
+            reader.setClipRect(clip);
+        }
+        return reader.read();
+    }
+
+    if (m_Image.isNull() && !m_Path.isEmpty())
+    {
+        QImageReader reader(m_Path);
+        reader.setAutoTransform(true);
+        if (!reader.read(&m_Image)) return QImage();
+        if (m_Scaled) m_Image = m_Image.scaled(m_Size, Qt::IgnoreAspectRatio);
+    }
+
+    if (top == 0 && rows == m_Image.height()) return m_Image;
+    return m_Image.copy(0, top, m_Image.width(), rows);
+}
+
+bool ImageTiles::isSameImage(const ImageTiles& other) const
+{
+    if (m_Path.isEmpty() || other.m_Path.isEmpty())
+    {
+        return m_Path.isEmpty() && other.m_Path.isEmpty() && m_Image.cacheKey() == other.m_Image.cacheKey();
+    }
+    return m_Path == other.m_Path && m_Modified == other.m_Modified && m_Size == other.m_Size;
+}
@@ -0,0 +1,50 @@
+#ifndef __IMAGETILES_H__
+#define __IMAGETILES_H__
+
+#include <QDateTime>
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+
+// The input image, handed out in strips of full width rows. Files whose format
+// can decode a clipped region (like JPEG) are decoded strip by strip, so only
+// one strip is held in memory at a time. Each strip decodes the file from the
+// top down to its last row again though, so the fewer strips the better.
+// Everything else (like PNG) is decoded whole, once, on the first read(), and
+// sliced.
+class ImageTiles
+{
+public:
+    ImageTiles() {}
+
+    // Whole image in memory
+    ImageTiles(const QImage& image);
+
+    // Scales the image down to fit 'maxSize' x 'maxSize' pixels, 0 keeps its size.
+    // Only reads the image header.
+    bool open(const QString& path, int maxSize = 0);
+
+    int width() const { return m_Size.width(); }
+    int height() const { return m_Size.height(); }
+    bool isNull() const { return m_Size.isEmpty(); }
+    // Whether read() decodes just the strip asked for, rather than slicing the whole image
+    bool decodesStrips() const { return m_Clipped; }
+
+    // Image rows [top, top + rows), counted from the top like in QImage. Null
+    // if the file can't be decoded.
+    QImage read(int top, int rows) const;
+
+    // Same file, unchanged on disk and at the same size, or the same image in memory
+    bool isSameImage(const ImageTiles& other) const;
+
+private:
+    QString m_Path;
+    QDateTime m_Modified;
+    QSize m_Size;
+    bool m_Scaled = false;
+    bool m_Clipped = false; // Read from the file strip by strip
+    mutable QImage m_Image;
+};
+
+#endif
@@ -1,12 +1,21 @@
 #include "lithophane.h"
 
 #include <stdio.h>
-#include <fstream>
-#include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 #include <QFile>
 #include <QtEndian>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "atomicfile.h"
+#include "decimator.h"
+#include "objwriter.h"
+#include "plywriter.h"
+#include "stlwriter.h"
+#include "threemfwriter.h"
 
 
 Lithophane::Lithophane() {}
@@ -15,20 +24,23 @@ Lithophane::~Lithophane() {}
 
 void Lithophane::reset()
 {
-    m_VerticesData.clear();
+    reclaimSurface();
+    m_Mesh.clear();
+    m_PreviewBuffer = IndexedVertexData();
+    imageRendered = false;
 }
 
 void Lithophane::configure(
-    const QImage& image,
+    const ImageTiles& image,
     float width,
     float totalThickness, float minThickness,
     float frameBorder, float frameSlopeFactor,
     bool permanentStabilizers,
     float stabilizerHeightFactor, float stabilizerThreshold,
-    uint32_t noOfHangers
+    uint32_t noOfHangers,
+    float meshTolerance
 )
 {
-    this->image = image;
     this->width = width;
     this->totalThickness = totalThickness;
     this->minThickness = minThickness;
@@ -38,303 +50,782 @@ void Lithophane::configure(
     this->permanentStabilizers = permanentStabilizers;
     this->stabilizerHeightFactor = stabilizerHeightFactor;
     this->stabilizerThreshold = stabilizerThreshold;
+    this->meshTolerance = meshTolerance;
+    if (!this->image.isSameImage(image))
+    {
+        this->image = image;
+        heightfield.clear();
+        surface.valid = false;
+    }
 
     widthFactor = (width - (frameBorder * 2.0f)) / image.width();
-    depthFactor = -1.0f * ((totalThickness - minThickness) / 255.0f);
     minThicknessInv = -1.0f * minThickness;
     totalHeight = ((frameBorder * 2.0f) + (image.height() * widthFactor));
 }
 
-void Lithophane::generate()
+std::tuple<bool, QString> Lithophane::saveToStl(const QString &path, const QString& format, const bool overrideFile,
+                                                const QByteArray& printSettings)
+{
+    return saveToStl(m_Mesh, path, format, overrideFile, printSettings);
+}
+
+std::tuple<bool, QString> Lithophane::saveToStl(const Mesh& mesh, const QString &path, const QString& format, const bool overrideFile,
+                                                const QByteArray& printSettings)
+{
+    if (mesh.isEmpty())
+    {
+        return {false, tr("There is currently no rendered lithophane in the STL buffer. You need to render one before you can export it.")};
+    }
+    if (QFile::exists(path) && !overrideFile)
+    {
+        return {false, tr("The output STL file already exists. Do you want to overwrite it?")};
+    }
+
+    progressReporter.start(tr("Exporting"), mesh.triangleCount(), tr("triangles"));
+    printf("Exporting to file: '%s'... \n", path.toStdString().c_str());
+
+    const QString temporaryPath = createTemporaryFile(path);
+    if (temporaryPath.isEmpty())
+    {
+        printf("Failed!\n");
+        return {false, tr("File could not be opened for writing. Please check export filename and try again.")};
+    }
+
+    const qint64 total = mesh.triangleCount();
+    const auto reportProgress = [this, total](int value) { progressReporter.setDone(value * total / 100); };
+    const bool compress = path.endsWith(".gz", Qt::CaseInsensitive);
+    bool written;
+    if (format == "3mf") written = write3mf(temporaryPath, mesh, printSettings, reportProgress);
+    else if (format == "ply") written = writePly(temporaryPath, mesh, reportProgress);
+    else if (format == "obj") written = writeObj(temporaryPath, mesh, reportProgress);
+    else if (format == "binary") written = writeBinaryStl(temporaryPath, mesh, reportProgress, compress);
+    else written = writeAsciiStl(temporaryPath, mesh, reportProgress, compress);
+    if (!written || !commitTemporaryFile(temporaryPath, path))
+    {
+        QFile::remove(temporaryPath);
+        printf("Failed!\n");
+        return {false, tr("The file could not be written completely. Please check the free disk space and try again.")};
+    }
+
+    progressReporter.finish();
+    printf("Success!\n");
+    if (format != "binary" && format != "ascii")
+    {
+        return {true, tr("The %1 file was successfully exported. You can now import it in your preferred 3D printing slicer.").arg(format.toUpper())};
+    }
+    return {true, tr("The binary STL was successfully exported. You can now import it in your preferred 3D printing slicer.")};
+}
+
+bool Lithophane::updateHeightfield()
+{
+    // A depth of 255 keeps the inverted gray values themselves, exactly, so
+    // thickness changes only scale them when the vertices are made
+    if (heightfield.isEmpty())
+    {
+        heightfield.build(image.read(0, image.height()), 255.0f);
+    }
+    return !heightfield.isEmpty();
+}
+
+bool Lithophane::generate()
+{
+    reclaimSurface();
+    if (!updateHeightfield()) return false;
+
+    setXDisplacement(-width / 2.0f);
+    const bool updated = updateSegment(surface, {width, frameBorder, totalThickness, minThickness, meshTolerance}, [this]() {
+        surfaceHeightmapVertices = meshTolerance > 0 ? renderImageAdaptive() : renderImage();
+    });
+    if (!updated || !updateFrameSegments()) return false;
+
+    // The surface is moved to the front of the mesh rather than copied, so
+    // there is only one full resolution copy of it
+    std::swap(surface.mesh, m_Mesh);
+    surface.mesh.clear();
+    surfaceVertices = m_Mesh.vertexCount();
+    surfaceTriangles = m_Mesh.triangleCount();
+    surfaceInMesh = true;
+    m_Mesh.append(frame.mesh);
+    m_Mesh.append(hangers.mesh);
+    m_Mesh.append(stabilizers.mesh);
+    imageRendered = true;
+    return true;
+}
+
+bool Lithophane::generateDetails()
+{
+    reclaimSurface();
+    setXDisplacement(-width / 2.0f);
+    if (!updateFrameSegments()) return false;
+
+    m_Mesh = frame.mesh;
+    m_Mesh.append(hangers.mesh);
+    m_Mesh.append(stabilizers.mesh);
+    imageRendered = false;
+    return true;
+}
+
+bool Lithophane::generatePreview(int maxTriangles)
+{
+    if (!updateHeightfield() || !generateDetails()) return false;
+
+    packCoarsePreview(maxTriangles, 1);
+    if (isCanceled())
+    {
+        m_PreviewBuffer = IndexedVertexData();
+        return false;
+    }
+    return true;
+}
+
+void Lithophane::updatePreviewBuffer(int maxTriangles)
+{
+    // Only an undecimated surface still matches the heightfield
+    const bool decimated = imageRendered && !surfaceInMesh;
+    if (m_Mesh.triangleCount() <= maxTriangles || heightfield.isEmpty() || decimated)
+    {
+        m_PreviewBuffer = m_Mesh.indexedVertexData();
+        return;
+    }
+    packCoarsePreview(maxTriangles, 2);
+}
+
+void Lithophane::packCoarsePreview(int maxTriangles, int minStep)
+{
+    // Whatever the frame, hangers and stabilizers leave of the budget goes to
+    // the surface, two triangles per grid cell
+    const Segment *details[] = {&frame, &hangers, &stabilizers};
+    int surfaceTriangles = maxTriangles;
+    for (const Segment *segment : details)
+    {
+        surfaceTriangles -= segment->mesh.triangleCount();
+    }
+    const double cells = (double)(heightfield.width() - 1) * (heightfield.height() - 1);
+    const int step = std::max(minStep, (int)std::ceil(std::sqrt(cells / std::max(1, surfaceTriangles / 2))));
+
+    // Built in m_Mesh like a segment, which is swapped out meanwhile. Only
+    // the packed buffer is kept.
+    Mesh fullMesh;
+    std::swap(fullMesh, m_Mesh);
+    setXDisplacement(-width / 2.0f);
+    renderImage(step);
+    m_Mesh.computeNormals();
+    for (const Segment *segment : details)
+    {
+        m_Mesh.append(segment->mesh);
+    }
+    m_PreviewBuffer = m_Mesh.indexedVertexData();
+    std::swap(fullMesh, m_Mesh);
+}
+
+void Lithophane::reclaimSurface()
+{
+    if (!surfaceInMesh) return;
+
+    // The frame, hangers and stabilizers follow the surface in m_Mesh
+    m_Mesh.truncate(surfaceVertices, surfaceTriangles);
+    std::swap(surface.mesh, m_Mesh);
+    m_Mesh.clear();
+    surfaceInMesh = false;
+}
+
+bool Lithophane::updateSegment(Segment& segment, const QVector<float>& key, const std::function<void()>& build)
 {
-    renderImage();
-    addFrame();
-    if(noOfHangers > 0) addHangers();
-    if(stabilizerThreshold > 0 and width > stabilizerThreshold) addStabilizers();
+    if (segment.valid && segment.key == key) return true;
+
+    // The add* helpers all build into m_Mesh, so the segment is built there and
+    // swapped out again, leaving m_Mesh as it was
+    std::swap(segment.mesh, m_Mesh);
+    m_Mesh.clear();
+    build();
+    std::swap(segment.mesh, m_Mesh);
+    // Done once per segment, generate() and the exports reuse them
+    segment.mesh.computeNormals();
+
+    segment.key = key;
+    segment.valid = !isCanceled();
+    return segment.valid;
 }
 
-void Lithophane::renderImage()
+bool Lithophane::updateFrameSegments()
 {
-    emit progress(0);
+    return updateSegment(frame, {width, totalHeight, totalThickness, minThickness, frameBorder, frameSlopeFactor}, [this]() {
+            addFrame();
+        }) &&
+        updateSegment(hangers, {width, totalHeight, minThickness, (float) noOfHangers}, [this]() {
+            if(noOfHangers > 0) addHangers();
+        }) &&
+        updateSegment(stabilizers, {width, totalHeight, totalThickness, minThickness, stabilizerHeightFactor, stabilizerThreshold}, [this]() {
+            if(stabilizerThreshold > 0 and width > stabilizerThreshold) addStabilizers();
+        });
+}
 
-    uint32_t numQuads = (image.width() - 1) * (image.height() - 1);
-    uint32_t numVertices = 4 * numQuads;
+namespace {
 
-    m_VerticesData.reserve(numVertices);
+// Corner of an image mesh quad: a heightmap sample, or the base of the side
+// wall below a sample on the image border
+struct GridPoint
+{
+    int x, y;
+    bool wallBase;
+};
 
-    for (int y = 0; y < (image.height() - 1); ++y)
+// Quads of heightmap rows [first, last) in mesh order: left wall, heightmap, right wall
+template<typename QuadFunction>
+void forEachRowQuad(int w, int first, int last, QuadFunction quad)
+{
+    for (int y = first; y < last; ++y)
     {
         // Close left side
-        addQuad(
-            {0, (float) y    , minThicknessInv          },
-            {0, (float) y    , getPixel(image, 0, y    )},
-            {0, (float) y + 1, getPixel(image, 0, y + 1)},
-            {0, (float) y + 1, minThicknessInv          },
-            true
-        );
+        quad(GridPoint{0, y, true}, GridPoint{0, y, false}, GridPoint{0, y + 1, false}, GridPoint{0, y + 1, true});
 
-        for (int x = 0; x < (image.width() - 1); ++x)
+        // The lithophane heightmap
+        for (int x = 0; x < w - 1; ++x)
         {
-            if (y == 0)
-            {
-                // Close bottom
-                addQuad(
-                    {(float) x + 1, 0, getPixel(image, x + 1, 0)},
-                    {(float) x    , 0, getPixel(image, x, 0)},
-                    {(float) x    , 0, minThicknessInv},
-                    {(float) x + 1, 0, minThicknessInv},
-                    true
-                );
-
-                // Close top
-                addQuad(
-                    {(float) x    , (float) image.height() - 1, minThicknessInv},
-                    {(float) x    , (float) image.height() - 1, getPixel(image, x    , image.height() - 1)},
-                    {(float) x + 1, (float) image.height() - 1, getPixel(image, x + 1, image.height() - 1)},
-                    {(float) x + 1, (float) image.height() - 1, minThicknessInv},
-                    true
-                );
-            }
-            // The lithophane heightmap
-            addQuad(
-                {(float) x    , (float) y    , getPixel(image, x    , y    )},
-                {(float) x + 1, (float) y    , getPixel(image, x + 1, y    )},
-                {(float) x + 1, (float) y + 1, getPixel(image, x + 1, y + 1)},
-                {(float) x    , (float) y + 1, getPixel(image, x    , y + 1)},
-                true
-            );
+            quad(GridPoint{x, y, false}, GridPoint{x + 1, y, false}, GridPoint{x + 1, y + 1, false}, GridPoint{x, y + 1, false});
         }
+
         // Close right side
-        addQuad(
-            {(float) image.width() - 1, (float) y + 1, getPixel(image, image.width() - 1, y + 1)},
-            {(float) image.width() - 1, (float) y    , getPixel(image, image.width() - 1, y    )},
-            {(float) image.width() - 1, (float) y    , minThicknessInv                          },
-            {(float) image.width() - 1, (float) y + 1, minThicknessInv                          },
-            true
-        );
+        quad(GridPoint{w - 1, y + 1, false}, GridPoint{w - 1, y, false}, GridPoint{w - 1, y, true}, GridPoint{w - 1, y + 1, true});
+    }
+}
 
-        emit this->progress((int)((float)y / (float)(image.height() - 1) * 100.0f));
+// Quads closing the bottom and the top of the heightmap
+template<typename QuadFunction>
+void forEachEndWallQuad(int w, int h, QuadFunction quad)
+{
+    for (int x = 0; x < w - 1; ++x)
+    {
+        // Close bottom
+        quad(GridPoint{x + 1, 0, false}, GridPoint{x, 0, false}, GridPoint{x, 0, true}, GridPoint{x + 1, 0, true});
+        // Close top
+        quad(GridPoint{x, h - 1, true}, GridPoint{x, h - 1, false}, GridPoint{x + 1, h - 1, false}, GridPoint{x + 1, h - 1, true});
     }
-    emit this->progress(100);
+}
 
-    // Backside
-    addQuad(
-        {0                        , (float) image.height() - 1, minThicknessInv},
-        {(float) image.width() - 1, (float) image.height() - 1, minThicknessInv},
-        {0                        , 0                         , minThicknessInv},
-        {(float) image.width() - 1, 0                         , minThicknessInv},
-        true
+int borderLength(int w, int h)
+{
+    return 2 * w + 2 * (h - 2);
+}
+
+// Wall base on the image border, counting clockwise (seen from the front) from
+// the bottom left corner: left bottom to top, top left to right, right top to
+// bottom, bottom right to left
+GridPoint borderPoint(int w, int h, int i)
+{
+    if (i < h) return {0, i, true};
+    i -= h - 1;
+    if (i < w) return {i, h - 1, true};
+    i -= w - 1;
+    if (i < h) return {w - 1, h - 1 - i, true};
+    i -= h - 1;
+    return {w - 1 - i, 0, true};
+}
+
+}
+
+int Lithophane::renderImage(int step)
+{
+    const int imageWidth = heightfield.width();
+    const int imageHeight = heightfield.height();
+    if (imageWidth < 2 || imageHeight < 2) return 0;
+
+    // The grid takes every step-th sample of each row and column plus the
+    // last ones, so a coarser surface still covers the whole image
+    const int w = (imageWidth - 2) / step + 2;
+    const int h = (imageHeight - 2) / step + 2;
+    auto sampleX = [step, imageWidth](int x) { return std::min(x * step, imageWidth - 1); };
+    auto sampleY = [step, imageHeight](int y) { return std::min(y * step, imageHeight - 1); };
+    const float scale = (totalThickness - minThickness) / 255.0f;
+
+    progressReporter.start(tr("Rendering"), h - 1, tr("rows"));
+
+    /* Vertex layout, relative to 'base':
+       [0, w * h)            heightmap surface, row by row
+       [w * h, + ringSize)   base of the side walls at minThicknessInv, in
+                             borderPoint() order
+       last                  centre of the backside
+
+       Triangle layout: (h - 1) rows of [left wall, heightmap, right wall] quads,
+       followed by the bottom and top walls and the backside fan. Every index is
+       known up front, so row bands can be filled in parallel and the result does
+       not depend on the number of threads.
+    */
+    const uint32_t base = m_Mesh.vertexCount();
+    const uint32_t ring = base + w * h;
+    const uint32_t ringSize = borderLength(w, h);
+    const uint32_t quadsPerRow = (w - 1) + 2;
+
+    auto index = [base, ring, w, h](const GridPoint& p) -> uint32_t {
+        if (!p.wallBase) return base + p.y * w + p.x;
+        if (p.x == 0) return ring + p.y;
+        if (p.y == h - 1) return ring + (h - 1) + p.x;
+        if (p.x == w - 1) return ring + (h - 1) + (w - 1) + (h - 1 - p.y);
+        return ring + 2 * (h - 1) + (w - 1) + (w - 1 - p.x);
+    };
+
+    const uint32_t firstTriangle = m_Mesh.triangleCount();
+    m_Mesh.resize(
+        ring + ringSize + 1,
+        firstTriangle + (h - 1) * 2 * quadsPerRow + 4 * (w - 1) + ringSize
     );
+    QVector3D *vertices = m_Mesh.vertices.data();
+    uint32_t *indices = m_Mesh.indices.data() + firstTriangle * 3;
+
+    // Heightmap rows [first, second) and the side walls next to them
+    auto buildBand = [&](const std::pair<int, int>& band) {
+        const int lastRow = (band.second == h - 1) ? h : band.second;
+        for (int y = band.first; y < lastRow; ++y)
+        {
+            const float *thickness = heightfield.row(sampleY(y));
+            for (int x = 0; x < w; ++x)
+            {
+                vertices[base + y * w + x] = getVertex(sampleX(x), sampleY(y), thickness[sampleX(x)] * scale, true);
+            }
+        }
+
+        uint32_t *out = indices + band.first * 6 * quadsPerRow;
+        forEachRowQuad(w, band.first, band.second, [&](const GridPoint& p1, const GridPoint& p2, const GridPoint& p3, const GridPoint& p4) {
+            out = Mesh::putQuad(out, index(p1), index(p2), index(p3), index(p4));
+        });
+        progressReporter.add(band.second - band.first);
+    };
+
+    constexpr int rowsPerBand = 16;
+    QVector<std::pair<int, int>> bands;
+    for (int y = 0; y < h - 1; y += rowsPerBand)
+    {
+        bands.append({y, std::min(y + rowsPerBand, h - 1)});
+    }
+
+    // Hand out a few bands per thread at a time so cancelation is noticed in between
+    const int batchSize = std::max(1, QThreadPool::globalInstance()->maxThreadCount() * 4);
+    for (int first = 0; first < bands.count(); first += batchSize)
+    {
+        const int last = std::min(first + batchSize, bands.count());
+        QtConcurrent::blockingMap(bands.begin() + first, bands.begin() + last, buildBand);
+        if (isCanceled()) return 0;
+    }
+
+    for (uint32_t i = 0; i < ringSize; ++i)
+    {
+        const GridPoint p = borderPoint(w, h, i);
+        vertices[ring + i] = getVertex(sampleX(p.x), sampleY(p.y), minThicknessInv, true);
+    }
+    const uint32_t centre = ring + ringSize;
+    vertices[centre] = getVertex((imageWidth - 1) / 2.0f, (imageHeight - 1) / 2.0f, minThicknessInv, true);
+
+    uint32_t *out = indices + (h - 1) * 6 * quadsPerRow;
+    forEachEndWallQuad(w, h, [&](const GridPoint& p1, const GridPoint& p2, const GridPoint& p3, const GridPoint& p4) {
+        out = Mesh::putQuad(out, index(p1), index(p2), index(p3), index(p4));
+    });
+
+    // Backside, fanned from the centre so every wall base vertex is shared (no T-junctions)
+    for (uint32_t i = 0; i < ringSize; ++i)
+    {
+        *out++ = centre;
+        *out++ = ring + i;
+        *out++ = ring + (i + 1) % ringSize;
+    }
+
+    progressReporter.finish();
+    return w * h;
 }
 
-std::tuple<bool, QString> Lithophane::saveToStl(const QString &path, const QString& format, const bool overrideFile)
+std::tuple<bool, QString> Lithophane::generateToStl(const QString& path, const bool overrideFile)
 {
-    emit this->progress(0);
+    const int w = image.width();
+    const int h = image.height();
+    if (w < 2 || h < 2)
+    {
+        return {false, tr("There is no image to generate the lithophane from. You need to load one before you can export it.")};
+    }
+    if (QFile::exists(path) && !overrideFile)
+    {
+        return {false, tr("The output STL file already exists. Do you want to overwrite it?")};
+    }
 
-    bool isBinaryOut = (format == "binary");
-    std::stringstream buffer;
+    printf("Streaming to file: '%s'... \n", path.toStdString().c_str());
+    progressReporter.start(tr("Exporting"), h - 1, tr("rows"));
 
-    std::ios_base::openmode open_mode = std::ios::trunc;
-    if(isBinaryOut) open_mode = std::ios::binary;
-    std::ofstream out(path.toStdString(), open_mode);
+    // The frame, hangers and stabilizers are small, so they come from the same
+    // cached segments generate() uses. They are built first, as compressed
+    // files need the facet count up front.
+    setXDisplacement(-width / 2.0f);
+    if (!updateFrameSegments())
+    {
+        printf("Failed!\n");
+        return {false, tr("The export was canceled.")};
+    }
+    const Segment *details[] = {&frame, &hangers, &stabilizers};
 
-    auto writeTriangle = [isBinaryOut, &out, &buffer](const QVector3D& normal, const QList<QVector3D> &points)
+    const int facetsPerRow = 2 * ((w - 1) + 2);
+    const int ringSize = borderLength(w, h);
+    uint32_t noOfFacets = (h - 1) * facetsPerRow + 4 * (w - 1) + ringSize;
+    for (const Segment *segment : details)
     {
-        static float normalx, normaly, normalz, x, y, z;
-        constexpr uint16_t attrByteCount = 0;
+        noOfFacets += segment->mesh.triangleCount();
+    }
 
-        normalx = normal.x();
-        normaly = normal.y();
-        normalz = normal.z();
+    const QString temporaryPath = createTemporaryFile(path);
+    StlStreamWriter writer;
+    if (temporaryPath.isEmpty() || !writer.open(temporaryPath, path.endsWith(".gz", Qt::CaseInsensitive), noOfFacets))
+    {
+        if (!temporaryPath.isEmpty()) QFile::remove(temporaryPath);
+        printf("Failed!\n");
+        return {false, tr("File could not be opened for writing. Please check export filename and try again.")};
+    }
 
-        if(isBinaryOut)
+    // Leaves no partial file behind, and any earlier file at 'path' untouched
+    auto abort = [&writer, &temporaryPath](const QString& message) -> std::tuple<bool, QString> {
+        writer.close();
+        QFile::remove(temporaryPath);
+        printf("Failed!\n");
+        return {false, message};
+    };
+
+    // Same triangles in the same order as generate() with renderImage(), but
+    // turned into facets band by band instead of being kept as a mesh
+    auto putQuad = [](char *out, const auto& position, const GridPoint& p1, const GridPoint& p2, const GridPoint& p3, const GridPoint& p4) {
+        const QVector3D v1 = position(p1), v2 = position(p2), v3 = position(p3), v4 = position(p4);
+        out = StlStreamWriter::putFacet(out, v1, v2, v3);
+        return StlStreamWriter::putFacet(out, v3, v4, v1);
+    };
+
+    // The heightmap is processed in tiles of rows [first, last], each sharing its
+    // last row with the next tile, with about 16 MB of thicknesses per tile.
+    // Only the bottom and top rows are kept for the walls closing the ends.
+    // Reading a tile decodes the file from the top down to the tile, so images
+    // decoded in strips get larger tiles instead of more of them.
+    Heightfield tile;
+    QVector<float> bottomRow, topRow;
+    auto position = [this, &tile](const GridPoint& p) {
+        return getVertex(p.x, p.y, p.wallBase ? minThicknessInv : tile.at(p.x, p.y), true);
+    };
+
+    struct Chunk
+    {
+        int first, last;
+        QByteArray facets;
+    };
+
+    // About 1 MB of facets per chunk. One batch of chunks is generated in parallel
+    // while the writer still works on the previous ones.
+    const int rowsPerChunk = std::max(1, (1 << 20) / (facetsPerRow * StlStreamWriter::facetSize));
+    auto buildChunk = [&](Chunk& chunk) {
+        chunk.facets.resize((chunk.last - chunk.first) * facetsPerRow * StlStreamWriter::facetSize);
+        char *out = chunk.facets.data();
+        forEachRowQuad(w, chunk.first, chunk.last, [&](const GridPoint& p1, const GridPoint& p2, const GridPoint& p3, const GridPoint& p4) {
+            out = putQuad(out, position, p1, p2, p3, p4);
+        });
+        progressReporter.add(chunk.last - chunk.first);
+    };
+
+    constexpr int maxDecodedTiles = 8;
+    int rowsPerTile = std::max(1, (4 << 20) / w);
+    if (image.decodesStrips()) rowsPerTile = std::max(rowsPerTile, (h - 1 + maxDecodedTiles - 1) / maxDecodedTiles);
+    const int batchSize = std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    QVector<Chunk> batch;
+    for (int first = 0; first < h - 1; first += rowsPerTile)
+    {
+        const int last = std::min(first + rowsPerTile, h - 1);
+        const QImage strip = image.read(h - 1 - last, last - first + 1);
+        if (strip.width() != w || strip.height() != last - first + 1)
         {
-            out.write((char *)&normalx, sizeof(float));
-            out.write((char *)&normaly, sizeof(float));
-            out.write((char *)&normalz, sizeof(float));
+            return abort(tr("The input image could not be read. Please check that it is a valid PNG or JPG image."));
         }
-        else {
-            buffer << "facet normal " << normalx << " " << normaly << " " << normalz << std::endl;
-            buffer << "outer loop" << std::endl;
+        tile.build(strip, totalThickness - minThickness, first);
+        if (first == 0)
+        {
+            bottomRow.resize(w);
+            std::copy(tile.row(0), tile.row(0) + w, bottomRow.begin());
+        }
+        if (last == h - 1)
+        {
+            topRow.resize(w);
+            std::copy(tile.row(h - 1), tile.row(h - 1) + w, topRow.begin());
         }
 
-        for(const QVector3D& p : points)
+        for (int y = first; y < last;)
         {
-            x = p.x();
-            y = p.y();
-            z = p.z();
-            if(isBinaryOut)
+            batch.clear();
+            for (int i = 0; i < batchSize && y < last; ++i, y += rowsPerChunk)
             {
-                out.write((char *)&x, sizeof(float));
-                out.write((char *)&y, sizeof(float));
-                out.write((char *)&z, sizeof(float));
+                batch.append({y, std::min(y + rowsPerChunk, last), QByteArray()});
             }
-            else
+            QtConcurrent::blockingMap(batch, buildChunk);
+            for (Chunk& chunk : batch)
             {
-                buffer << "vertex " << p.x() << " " << p.y() << " " << p.z() << std::endl;                
+                writer.write(std::move(chunk.facets));
             }
+            if (isCanceled()) return abort(tr("The export was canceled."));
         }
-        
-        if(isBinaryOut)
-        {
-            out.write((char *)&attrByteCount, sizeof(uint16_t));
-        }
-        else
-        {
-            buffer << "endloop" << std::endl;
-            buffer << "endfacet" << std::endl;
-        }
+    }
+    tile.clear();
+
+    auto edgePosition = [this, &bottomRow, &topRow](const GridPoint& p) {
+        const float thickness = p.wallBase ? minThicknessInv : (p.y == 0 ? bottomRow : topRow).at(p.x);
+        return getVertex(p.x, p.y, thickness, true);
     };
 
-    if (m_VerticesData.isEmpty())
+    QByteArray closing((4 * (w - 1) + ringSize) * StlStreamWriter::facetSize, 0);
+    char *out = closing.data();
+    forEachEndWallQuad(w, h, [&](const GridPoint& p1, const GridPoint& p2, const GridPoint& p3, const GridPoint& p4) {
+        out = putQuad(out, edgePosition, p1, p2, p3, p4);
+    });
+    const QVector3D centre = getVertex((w - 1) / 2.0f, (h - 1) / 2.0f, minThicknessInv, true);
+    for (int i = 0; i < ringSize; ++i)
     {
-        return {false, tr("There is currently no rendered lithophane in the STL buffer. You need to render one before you can export it.")};
+        out = StlStreamWriter::putFacet(out, centre, edgePosition(borderPoint(w, h, i)), edgePosition(borderPoint(w, h, (i + 1) % ringSize)));
     }
-    if (QFile::exists(path) && !overrideFile)
+    writer.write(std::move(closing));
+
+    for (const Segment *segment : details)
     {
-        return {false, tr("The output STL file already exists. Do you want to overwrite it?")};
+        const Mesh &mesh = segment->mesh;
+        QByteArray facets(mesh.triangleCount() * StlStreamWriter::facetSize, 0);
+        out = facets.data();
+        for (int t = 0; t < mesh.triangleCount(); ++t)
+        {
+            out = StlStreamWriter::putFacet(out, mesh.normal(t), mesh.vertex(t, 0), mesh.vertex(t, 1), mesh.vertex(t, 2));
+        }
+        writer.write(std::move(facets));
     }
 
-    printf("Exporting to file: '%s'... \n", path.toStdString().c_str());
+    if (!writer.close() || !commitTemporaryFile(temporaryPath, path))
+    {
+        QFile::remove(temporaryPath);
+        printf("Failed!\n");
+        return {false, tr("The STL file could not be written completely. Please check the free disk space and try again.")};
+    }
 
-    QVector3D normal;
+    progressReporter.finish();
+    printf("Success!\n");
+    return {true, tr("The binary STL was successfully exported. You can now import it in your preferred 3D printing slicer.")};
+}
 
-    if (out.good())
+bool Lithophane::decimate(int targetTriangles, float maxError)
+{
+    QVector<uint8_t> locked;
+    if (imageRendered)
     {
-        if(isBinaryOut)
+        // Only the inside of the image surface may move. The side walls, the
+        // backside, the frame, hangers and stabilizers keep their exact shape.
+        // They are told apart by where generate() put them in the mesh, which
+        // a decimated mesh no longer shows, so that one stays as it is.
+        locked.fill(1, m_Mesh.vertexCount());
+        if (surfaceInMesh)
         {
-            char title[80];
-            memset(title, 0, 80);
-            strcpy(title, "lithophane");
-            out.write((char *)&title, 80);
-
-            uint32_t polCount = m_VerticesData.length() / 3;
-            if(QSysInfo::ByteOrder == QSysInfo::BigEndian)
+            // The outline of the heightmap carries the side walls
+            const float margin = widthFactor * 0.5f;
+            const float left = frameBorder + xDisplacement + margin;
+            const float right = frameBorder + xDisplacement + (heightfield.width() - 1) * widthFactor - margin;
+            const float bottom = frameBorder + margin;
+            const float top = frameBorder + (heightfield.height() - 1) * widthFactor - margin;
+            for (int i = 0; i < surfaceHeightmapVertices; ++i)
             {
-                polCount = qToLittleEndian(polCount);
+                const QVector3D &v = m_Mesh.vertices.at(i);
+                locked[i] = !(v.x() > left && v.x() < right && v.y() > bottom && v.y() < top);
             }
-
-            out.write((char *)&polCount, sizeof(uint32_t));
-        }
-        else buffer << "solid lithophane" << std::endl;
-        
-        for (int a = 0; a < m_VerticesData.length(); a += 3)
-        {
-            normal = QVector3D::normal(
-                m_VerticesData.at(a), m_VerticesData.at(a + 1), m_VerticesData.at(a + 2)
-            );
-            writeTriangle(
-                normal,
-                {m_VerticesData.at(a),
-                 m_VerticesData.at(a + 1),
-                 m_VerticesData.at(a + 2)}
-            );
-
-            emit this->progress((int)((float)a / (float)(m_VerticesData.length()) * 100.0f));
         }
+    }
+
+    // The surface cached in the mesh doesn't survive the simplification
+    if (surfaceInMesh)
+    {
+        surfaceInMesh = false;
+        surface.valid = false;
+    }
+
+    Decimator decimator(m_Mesh);
+    decimator.setLocked(locked);
+    progressReporter.start(tr("Reducing triangles"), 100);
+    decimator.run(targetTriangles, maxError, [this](int value) { progressReporter.setDone(value); }, [this]() { return isCanceled(); });
+    if (isCanceled()) return false;
+
+    m_Mesh.computeNormals();
+    progressReporter.finish();
+    return true;
+}
+
+namespace {
+
+struct QuadtreeLeaf
+{
+    int x, y, size;
+};
+
+struct ThicknessRange
+{
+    float min, max;
+    bool mergeable;
+};
+
+// Post-order walk over the quadtree cell of 'size' x 'size' pixel quads at (x, y).
+// A cell may merge when all its children may and its thickness range stays within
+// the tolerance; the first cell up the tree that may not merge emits its mergeable
+// children as leaves. Heightfield values times 'scale' are the thicknesses.
+ThicknessRange collectLeaves(const Heightfield& heightfield, float scale, float tolerance,
+                             int x, int y, int size, QVector<QuadtreeLeaf>& leaves)
+{
+    const int cellsX = heightfield.width() - 1;
+    const int cellsY = heightfield.height() - 1;
+
+    if (size == 1)
+    {
+        const float t1 = heightfield.at(x, y) * scale, t2 = heightfield.at(x + 1, y) * scale;
+        const float t3 = heightfield.at(x, y + 1) * scale, t4 = heightfield.at(x + 1, y + 1) * scale;
+        return {std::min(std::min(t1, t2), std::min(t3, t4)), std::max(std::max(t1, t2), std::max(t3, t4)), true};
+    }
 
-        if(!isBinaryOut)
+    const int half = size / 2;
+    const int childX[4] = {x, x + half, x, x + half};
+    const int childY[4] = {y, y, y + half, y + half};
+
+    ThicknessRange children[4];
+    ThicknessRange range = {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), true};
+    for (int c = 0; c < 4; ++c)
+    {
+        if (childX[c] >= cellsX || childY[c] >= cellsY)
         {
-            buffer << "endsolid" << std::endl;
-            // Write buffer to disc all at once
-            printf("writing file to disc...\n");
-            out << buffer.str();
+            children[c].mergeable = false;
+            continue;
         }
-        out.close();
-        
-        emit this->progress(100);
-        printf("Success!\n");
-        return {true, tr("The binary STL was successfully exported. You can now import it in your preferred 3D printing slicer.")};
+        children[c] = collectLeaves(heightfield, scale, tolerance, childX[c], childY[c], half, leaves);
+        range.min = std::min(range.min, children[c].min);
+        range.max = std::max(range.max, children[c].max);
+        range.mergeable = range.mergeable && children[c].mergeable;
     }
-    else
+
+    const bool inside = x + size <= cellsX && y + size <= cellsY;
+    range.mergeable = range.mergeable && inside && range.max - range.min <= tolerance;
+    if (!range.mergeable)
     {
-        printf("Failed!\n");
-        return {false, tr("File could not be opened for writing. Please check export filename and try again.")};
+        for (int c = 0; c < 4; ++c)
+        {
+            if (children[c].mergeable) leaves.append({childX[c], childY[c], half});
+        }
     }
+    return range;
 }
 
-void Lithophane::generate()
-{
-    setXDisplacement(-width / 2.0f);
-    renderImage();
-    // addFrame();
-    // if(noOfHangers > 0) addHangers();
-    // if(stabilizerThreshold > 0 and width > stabilizerThreshold) addStabilizers();
 }
 
-void Lithophane::renderImage()
+int Lithophane::renderImageAdaptive()
 {
-    emit progress(0);
+    const int w = heightfield.width();
+    const int h = heightfield.height();
+    if (w < 2 || h < 2) return 0;
+    const float scale = (totalThickness - minThickness) / 255.0f;
+
+    progressReporter.start(tr("Rendering"), 100);
 
-    uint32_t numQuads = (image.width() - 1) * (image.height() - 1);
-    uint32_t numVertices = 4 * numQuads;
+    // Merge pixel quads into power-of-two cells whose thickness varies by no more
+    // than meshTolerance, so no merged triangle strays further than that from the image
+    QVector<QuadtreeLeaf> leaves;
+    int rootSize = 1;
+    while (rootSize < std::max(w - 1, h - 1)) rootSize *= 2;
+    if (collectLeaves(heightfield, scale, meshTolerance, 0, 0, rootSize, leaves).mergeable)
+    {
+        leaves.append({0, 0, rootSize});
+    }
+    if (isCanceled()) return 0;
 
-    m_VerticesData.clear();
-    m_VerticesData.reserve(numVertices);
+    progressReporter.setDone(40);
 
-    for (int y = 0; y < image.height() - 1; ++y)
+    // Only grid points that are leaf corners become vertices. A leaf with corners
+    // of smaller neighbours on its sides is fanned from its centre instead of split
+    // in two, which keeps the surface free of T-junctions.
+    QVector<uint8_t> used(w * h, 0);
+    for (const QuadtreeLeaf& leaf : leaves)
     {
-        // Close left side
-        addQuad(
-            {0, (float) y    , minThicknessInv          },
-            {0, (float) y    , getPixel(image, 0, y    )},
-            {0, (float) y + 1, getPixel(image, 0, y + 1)},
-            {0, (float) y + 1, minThicknessInv          },
-            true
-        );
+        used[leaf.y * w + leaf.x] = 1;
+        used[leaf.y * w + leaf.x + leaf.size] = 1;
+        used[(leaf.y + leaf.size) * w + leaf.x] = 1;
+        used[(leaf.y + leaf.size) * w + leaf.x + leaf.size] = 1;
+    }
+
+    // Corners of a leaf in counterclockwise order (seen from the front), including
+    // the corners of neighbouring leaves lying on its sides
+    auto leafOutline = [&used, w](const QuadtreeLeaf& leaf, QVector<uint32_t>& outline) {
+        outline.clear();
+        const int x0 = leaf.x, y0 = leaf.y, x1 = leaf.x + leaf.size, y1 = leaf.y + leaf.size;
+        for (int x = x0; x < x1; ++x) if (used[y0 * w + x]) outline.append(y0 * w + x);
+        for (int y = y0; y < y1; ++y) if (used[y * w + x1]) outline.append(y * w + x1);
+        for (int x = x1; x > x0; --x) if (used[y1 * w + x]) outline.append(y1 * w + x);
+        for (int y = y1; y > y0; --y) if (used[y * w + x0]) outline.append(y * w + x0);
+    };
+
+    QVector<uint32_t> outline;
+    for (const QuadtreeLeaf& leaf : leaves)
+    {
+        leafOutline(leaf, outline);
+        if (outline.count() > 4)
+        {
+            used[(leaf.y + leaf.size / 2) * w + leaf.x + leaf.size / 2] = 2;
+        }
+    }
+
+    const uint32_t base = m_Mesh.vertexCount();
+    QVector<uint32_t> surfaceIndex(w * h);
+    for (int y = 0; y < h; ++y)
+    {
+        const float *thickness = heightfield.row(y);
+        for (int x = 0; x < w; ++x)
+        {
+            if (used[y * w + x]) surfaceIndex[y * w + x] = addVertex({(float) x, (float) y, thickness[x] * scale}, true);
+        }
+    }
 
-        for (int x = 0; x < image.width() - 1; ++x)
+    if (isCanceled()) return 0;
+
+    progressReporter.setDone(70);
+
+    for (const QuadtreeLeaf& leaf : leaves)
+    {
+        leafOutline(leaf, outline);
+        if (outline.count() == 4)
+        {
+            m_Mesh.addQuad(surfaceIndex[outline[0]], surfaceIndex[outline[1]], surfaceIndex[outline[2]], surfaceIndex[outline[3]]);
+        }
+        else
         {
-            if (y == 0)
+            const uint32_t centre = surfaceIndex[(leaf.y + leaf.size / 2) * w + leaf.x + leaf.size / 2];
+            for (int i = 0; i < outline.count(); ++i)
             {
-                // Close bottom
-                addQuad(
-                    {(float) x + 1, 0, getPixel(image, x + 1, 0)},
-                    {(float) x    , 0, getPixel(image, x, 0)},
-                    {(float) x    , 0, minThicknessInv},
-                    {(float) x + 1, 0, minThicknessInv},
-                    true
-                );
-
-                // Close top
-                addQuad(
-                    {(float) x    , (float) image.height() - 1, minThicknessInv},
-                    {(float) x    , (float) image.height() - 1, getPixel(image, x    , image.height() - 1)},
-                    {(float) x + 1, (float) image.height() - 1, getPixel(image, x + 1, image.height() - 1)},
-                    {(float) x + 1, (float) image.height() - 1, minThicknessInv},
-                    true
-                );
+                m_Mesh.addTriangle(centre, surfaceIndex[outline[i]], surfaceIndex[outline[(i + 1) % outline.count()]]);
             }
-            // The lithophane heightmap
-            addQuad(
-                {(float) x    , (float) y    , getPixel(image, x    , y    )},
-                {(float) x + 1, (float) y    , getPixel(image, x + 1, y    )},
-                {(float) x + 1, (float) y + 1, getPixel(image, x + 1, y + 1)},
-                {(float) x    , (float) y + 1, getPixel(image, x    , y + 1)},
-                true
-            );
         }
-        // Close right side
-        addQuad(
-            {(float) image.width() - 1, (float) y + 1, getPixel(image, image.width() - 1, y + 1)},
-            {(float) image.width() - 1, (float) y    , getPixel(image, image.width() - 1, y    )},
-            {(float) image.width() - 1, (float) y    , minThicknessInv                          },
-            {(float) image.width() - 1, (float) y + 1, minThicknessInv                          },
-            true
-        );
+    }
+
+    // Border vertices clockwise (seen from the front), starting in the bottom left corner
+    QVector<uint32_t> border;
+    for (int y = 0; y < h; ++y) if (used[y * w]) border.append(y * w);
+    for (int x = 1; x < w; ++x) if (used[(h - 1) * w + x]) border.append((h - 1) * w + x);
+    for (int y = h - 2; y >= 0; --y) if (used[y * w + w - 1]) border.append(y * w + w - 1);
+    for (int x = w - 2; x > 0; --x) if (used[x]) border.append(x);
 
-        emit this->progress((int)((float)y / (float)(image.height() - 1) * 100.0f));
+    const uint32_t ring = m_Mesh.vertexCount();
+    for (uint32_t position : border)
+    {
+        addVertex({(float) (position % w), (float) (position / w), minThicknessInv}, true);
     }
-    emit this->progress(100);
+    const uint32_t centre = addVertex({(w - 1) / 2.0f, (h - 1) / 2.0f, minThicknessInv}, true);
 
-    // Backside
-    addQuad(
-        {0                        , 0                         , minThicknessInv},
-        {0                        , (float) image.height() - 1, minThicknessInv},
-        {(float) image.width() - 1, (float) image.height() - 1, minThicknessInv},
-        {(float) image.width() - 1, 0                         , minThicknessInv},
-        true
-    );
+    const int ringSize = border.count();
+    for (int i = 0; i < ringSize; ++i)
+    {
+        const int next = (i + 1) % ringSize;
+
+        // Side walls between neighbouring border vertices
+        m_Mesh.addQuad(ring + i, surfaceIndex[border[i]], surfaceIndex[border[next]], ring + next);
+
+        // Backside, fanned from the centre
+        m_Mesh.addTriangle(centre, ring + i, ring + next);
+    }
+
+    progressReporter.finish();
+    return ring - base;
 }
 
 void Lithophane::addFrame()
@@ -343,11 +834,12 @@ void Lithophane::addFrame()
     float h = totalHeight;
     float depth = (totalThickness - minThickness);
     float frameSlope = (depth * frameSlopeFactor);
+    const int firstVertex = m_Mesh.vertexCount();
 
     addTriangle({w, h, minThicknessInv}, {0.0f, h, minThicknessInv}, {0.0f, h, depth});
     addTriangle({w, h, minThicknessInv}, {0.0f, h, depth}, {w, h, depth});
-    addTriangle({w - frameBorder - frameSlope, frameBorder + frameSlope, 0.0f}, {frameBorder + frameSlope, h - frameBorder - frameSlope, 0.0f}, {w - frameBorder - frameSlope, h - frameBorder - frameSlope, 0.0f});
-    addTriangle({w - frameBorder - frameSlope, frameBorder + frameSlope, 0.0f}, {frameBorder + frameSlope, frameBorder + frameSlope, 0.0f}, {frameBorder + frameSlope, h - frameBorder - frameSlope, 0.0f});
+    addTriangle({w - frameBorder - frameSlope, frameBorder + frameSlope, 0.0f}, {w - frameBorder - frameSlope, h - frameBorder - frameSlope, 0.0f}, {frameBorder + frameSlope, h - frameBorder - frameSlope, 0.0f});
+    addTriangle({w - frameBorder - frameSlope, frameBorder + frameSlope, 0.0f}, {frameBorder + frameSlope, h - frameBorder - frameSlope, 0.0f}, {frameBorder + frameSlope, frameBorder + frameSlope, 0.0f});
     addTriangle({0.0f, 0.0f, depth}, {0.0f, h, depth}, {0.0f, h, minThicknessInv});
     addTriangle({0.0f, 0.0f, depth}, {0.0f, h, minThicknessInv}, {0.0f, 0.0f, minThicknessInv});
     addTriangle({0.0f, 0.0f, minThicknessInv}, {w, 0.0f, minThicknessInv}, {w, 0.0f, depth});
@@ -372,6 +864,9 @@ void Lithophane::addFrame()
     addTriangle({frameBorder + frameSlope, h - frameBorder - frameSlope, 0.0f}, {w - frameBorder, h - frameBorder, depth}, {frameBorder, h - frameBorder, depth});
     addTriangle({w - frameBorder - frameSlope, frameBorder + frameSlope, 0.0f}, {frameBorder + frameSlope, frameBorder + frameSlope, 0.0f}, {frameBorder, frameBorder, depth});
     addTriangle({w - frameBorder - frameSlope, frameBorder + frameSlope, 0.0f}, {frameBorder, frameBorder, depth}, {w - frameBorder, frameBorder, depth}); 
+
+    // The helpers give each triangle corners of its own, welded into one solid here
+    m_Mesh.weldVertices(firstVertex);
 }
 
 void Lithophane::addHangers()
@@ -388,6 +883,7 @@ void Lithophane::addHangers()
 
     for (uint8_t a = 0; a < noOfHangers; a++)
     {
+        const int firstVertex = m_Mesh.vertexCount();
         addTriangle({x + 3, h, minThicknessInv}, {x, h, minThicknessInv}, {x + 3, h + 3, minThicknessInv}); 
         addTriangle({x + 3, h + 3, minThicknessInv}, {x + 6, h + 3, minThicknessInv}, {x + 9, h, minThicknessInv});
         addTriangle({x + 9, h, minThicknessInv}, {x + 6, h, minThicknessInv}, {x + 5, h + 1, minThicknessInv});
@@ -415,6 +911,7 @@ void Lithophane::addHangers()
         addTriangle({x + 6, h + 3, minThicknessInv}, {x + 3, h + 3, hangerWidth - minThickness}, {x + 6, h + 3, hangerWidth - minThickness}); 
         addTriangle({x + 3, h, minThicknessInv}, {x + 4, h + 1, minThicknessInv}, {x + 4, h + 1, hangerWidth - minThickness}); 
         addTriangle({x + 3, h, minThicknessInv}, {x + 4, h + 1, hangerWidth - minThickness}, {x + 3, h, hangerWidth - minThickness}); 
+        m_Mesh.weldVertices(firstVertex);
 
         // Move over to the next hanger placement
         x += xDelta * 2;
@@ -439,6 +936,7 @@ void Lithophane::addStabilizers()
 
     // Left stabilizer
     float x = 0.0f - stabSeparation;
+    int firstVertex = m_Mesh.vertexCount();
     addTriangle({x, h, zp}, {x, 0.0f,  w}, {x, 0.0f, zp});
     addTriangle({x, h, zn}, {x, 0.0f, zn}, {x, 0.0f, -w});
     addQuad(
@@ -456,9 +954,22 @@ void Lithophane::addStabilizers()
         {x, 0.0f, zn},
         {x, 0.0f, zp}
     );
+    // The bottom is split where the side walls have corners, so their edges meet
     addQuad( // bottom
         {x + stabWidth, 0.0f,  w},
         {x            , 0.0f,  w},
+        {x            , 0.0f, zp},
+        {x + stabWidth, 0.0f, zp}
+    );
+    addQuad(
+        {x + stabWidth, 0.0f, zp},
+        {x            , 0.0f, zp},
+        {x            , 0.0f, zn},
+        {x + stabWidth, 0.0f, zn}
+    );
+    addQuad(
+        {x + stabWidth, 0.0f, zn},
+        {x            , 0.0f, zn},
         {x            , 0.0f, -w},
         {x + stabWidth, 0.0f, -w}
     );
@@ -480,9 +991,11 @@ void Lithophane::addStabilizers()
         {x + stabWidth, 0.0f, -w},
         {x            , 0.0f, -w}
     );
+    m_Mesh.weldVertices(firstVertex);
 
     // // Right Stabilizer
     x = (float) width + stabSeparation;
+    firstVertex = m_Mesh.vertexCount();
     addTriangle({x, h, zp}, {x, 0.0f, zp}, {x, 0.0f,  w});
     addTriangle({x, h, zn}, {x, 0.0f, -w}, {x, 0.0f, zn});
     addQuad(
@@ -503,6 +1016,18 @@ void Lithophane::addStabilizers()
     addQuad( // bottom
         {x            , 0.0f,  w},
         {x - stabWidth, 0.0f,  w},
+        {x - stabWidth, 0.0f, zp},
+        {x            , 0.0f, zp}
+    );
+    addQuad(
+        {x            , 0.0f, zp},
+        {x - stabWidth, 0.0f, zp},
+        {x - stabWidth, 0.0f, zn},
+        {x            , 0.0f, zn}
+    );
+    addQuad(
+        {x            , 0.0f, zn},
+        {x - stabWidth, 0.0f, zn},
         {x - stabWidth, 0.0f, -w},
         {x            , 0.0f, -w}
     );
@@ -524,6 +1049,7 @@ void Lithophane::addStabilizers()
         {x            , 0.0f, -w},
         {x - stabWidth, 0.0f, -w}
     );
+    m_Mesh.weldVertices(firstVertex);
 
     // Unions
     float y = h;
@@ -1,7 +1,11 @@
 #ifndef __LITHOPHANE_H__
 #define __LITHOPHANE_H__
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <tuple>
+#include <utility>
 
 #include <cmath>
 
@@ -10,6 +14,10 @@
 #include <QVector3D>
 #include <QList>
 
+#include "mesh.h"
+#include "heightfield.h"
+#include "imagetiles.h"
+#include "progressreporter.h"
 
 class Lithophane : public QObject
 {
@@ -19,31 +27,96 @@ public:
     Lithophane();
     ~Lithophane();
 
+    // Drops the rendered mesh. The parts it was made of stay cached for generate().
     void reset();
     void configure(
-        const QImage& image,
+        const ImageTiles& image,
         float width,
         float totalThickness, float minThickness,
         float frameBorder, float frameSlopeFactor,
         bool permanentStabilizers = false,
         float stabilizerHeightFactor = 0.15f, float stabilizerThreshold = 0,
-        uint32_t noOfHangers = 0
+        uint32_t noOfHangers = 0,
+        float meshTolerance = 0.0f
     );
-    void generate();
-    const QList<QVector3D>& getVertices() const { return m_VerticesData; }
-    std::tuple<bool, QString> saveToStl(const QString& path, const QString& format, const bool overrideFile);
+    // Only rebuilds the parts of the lithophane (image, frame, hangers and
+    // stabilizers) whose parameters changed since the last call. Returns false
+    // when canceled or when the image can't be read.
+    bool generate();
+    // For a preview drawing the image surface on the graphics card: builds
+    // only the frame, hangers and stabilizers into the mesh. Quick enough to
+    // run on every slider change. Returns false when canceled.
+    bool generateDetails();
+    // For live previews while the sliders move: builds the frame, hangers and
+    // stabilizers into the mesh like generateDetails(), and packs them with an
+    // image surface of about 'maxTriangles' triangles at most for
+    // takePreviewBuffer(), without building the full resolution surface.
+    // Returns false when canceled or when the image can't be read.
+    bool generatePreview(int maxTriangles);
+    // False while the mesh lacks the image surface, e.g. after generateDetails()
+    bool isImageRendered() const { return imageRendered; }
+    // As last configured
+    const ImageTiles& getImage() const { return image; }
+    // The input image in grayscale at the size it is rendered at, null if it
+    // can't be read
+    QImage getGrayscaleImage() const { return image.read(0, image.height()).convertToFormat(QImage::Format_Grayscale8); }
+    // Returns false when canceled, leaving a partly simplified mesh behind
+    bool decimate(int targetTriangles, float maxError);
+    const Mesh& getMesh() const { return m_Mesh; }
+    // Immutable copy of the current mesh for use on other threads. The mesh
+    // data is implicitly shared, so this copies nothing until the lithophane
+    // changes its own mesh, e.g. by rendering again.
+    std::shared_ptr<const Mesh> getMeshSnapshot() const { return std::make_shared<const Mesh>(m_Mesh); }
+    // Packs the mesh shown by the 3D preview after generate() or decimate(),
+    // with about 'maxTriangles' triangles at most, as Mesh::indexedVertexData().
+    // A larger mesh gets its image surface rendered again from every n-th
+    // heightmap sample, with the same frame, hangers and stabilizers. Exports
+    // still use the full mesh. A decimated mesh is packed as it is, however
+    // large, so the preview shows what gets exported.
+    void updatePreviewBuffer(int maxTriangles);
+    // Hands the packed buffers over, leaving none behind
+    IndexedVertexData takePreviewBuffer() { return std::move(m_PreviewBuffer); }
+    // 'format' is "ascii" or "binary" STL, "3mf", "ply" or "obj". STL files are
+    // gzip compressed when 'path' ends in ".gz". 'printSettings' is a
+    // PrusaSlicer .ini embedded in 3MF files when not empty. The file is
+    // written next to 'path' and only replaces it once complete.
+    std::tuple<bool, QString> saveToStl(const QString& path, const QString& format, const bool overrideFile,
+                                        const QByteArray& printSettings = QByteArray());
+    // Same for any mesh, such as a snapshot of another lithophane's
+    std::tuple<bool, QString> saveToStl(const Mesh& mesh, const QString& path, const QString& format, const bool overrideFile,
+                                        const QByteArray& printSettings = QByteArray());
+
+    // Generates the lithophane straight into a binary STL file without keeping
+    // the mesh in memory. The heightmap is built in tiles of rows. Images that
+    // can be decoded in strips (like JPEG) are read in at most 8 tiles, as each
+    // one decodes the file from the top again, and are never held in memory
+    // whole. Others (like PNG) are decoded whole first. Always uses the full
+    // resolution heightmap. The file is gzip compressed when 'path' ends in
+    // ".gz", and replaces 'path' only once complete.
+    std::tuple<bool, QString> generateToStl(const QString& path, const bool overrideFile);
 
     float getHeight() { return totalHeight; }
+    float getWidth() { return width; }
+
+    // Makes generate(), decimate() or generateToStl() running on another thread
+    // stop at the next opportunity. Stays set until cleared with setCanceled(false).
+    void setCanceled(bool canceled) { this->canceled = canceled; }
+    bool isCanceled() const { return canceled; }
 
     // SPHERE
     void uv_sphere(uint32_t n_slices, uint32_t n_stacks, float radius=10.0f, bool inner = false)
     {
         setXDisplacement(0.0f);
 
-        QList<QVector3D> vertices;
+        const uint32_t base = m_Mesh.vertexCount();
+        m_Mesh.reserve(
+            base + n_slices * (n_stacks - 1) + 2,
+            m_Mesh.triangleCount() + 2 * n_slices * (n_stacks - 1)
+        );
+
         // top vertex
         QVector3D v0 = {0, 1.0f, 0};
-        vertices.append(v0);
+        const uint32_t top = addVertex(v0);
 
         float inc = 1.0f;
         const int ll = (n_stacks / 2) - 100;
@@ -63,37 +136,37 @@ public:
                 if(!inner && i >= ll && i <= lh && j >= ll && j <= lh) inc = 1.1f;
                 else inc = 1.0f;
                 
-                vertices.append(QVector3D{x, y, z} * radius * inc);
+                addVertex(QVector3D{x, y, z} * radius * inc);
             }
         }
 
         // bottom vertex
         QVector3D v1 = {0, -1.0f, 0};
-        vertices.append(v1 * radius);
+        const uint32_t bottom = addVertex(v1);
 
         // top / bottom triangles
         for (uint32_t i = 0; i < n_slices; ++i)
         {
-            uint32_t i0 = i + 1;
-            uint32_t i1 = (i + 1) % n_slices + 1;
+            uint32_t i0 = base + i + 1;
+            uint32_t i1 = base + (i + 1) % n_slices + 1;
             if(!inner)
-                addTriangle(v0, vertices.at(i1), vertices.at(i0));
+                m_Mesh.addTriangle(top, i1, i0);
             else
-                addTriangle(v0, vertices.at(i0), vertices.at(i1));
+                m_Mesh.addTriangle(top, i0, i1);
 
-            i0 = i + n_slices * (n_stacks - 2) + 1;
-            i1 = (i + 1) % n_slices + n_slices * (n_stacks - 2) + 1;
+            i0 = base + i + n_slices * (n_stacks - 2) + 1;
+            i1 = base + (i + 1) % n_slices + n_slices * (n_stacks - 2) + 1;
             if(!inner)
-                addTriangle(v1, vertices.at(i0), vertices.at(i1));
+                m_Mesh.addTriangle(bottom, i0, i1);
             else
-                addTriangle(v1, vertices.at(i1), vertices.at(i0));
+                m_Mesh.addTriangle(bottom, i1, i0);
         }
 
         // add quads per stack / slice
         for (uint32_t j = 0; j < n_stacks - 2; j++)
         {
-            uint32_t j0 = j * n_slices + 1;
-            uint32_t j1 = (j + 1) * n_slices + 1;
+            uint32_t j0 = base + j * n_slices + 1;
+            uint32_t j1 = base + (j + 1) * n_slices + 1;
             for (uint32_t i = 0; i < n_slices; i++)
             {
                 uint32_t i0 = j0 + i;
@@ -101,28 +174,45 @@ public:
                 uint32_t i2 = j1 + (i + 1) % n_slices;
                 uint32_t i3 = j1 + i;
                 if(!inner)
-                    addQuad(vertices.at(i0), vertices.at(i1), vertices.at(i2), vertices.at(i3));
+                    m_Mesh.addQuad(i0, i1, i2, i3);
                 else
-                    addQuad(vertices.at(i0), vertices.at(i3), vertices.at(i2), vertices.at(i1));
+                    m_Mesh.addQuad(i0, i3, i2, i1);
             }
         }
     }
     // ------
 
-signals:
-    void progress(int value); // 0 - 100%
+    // Reports the progress of rendering, reducing and exporting
+    ProgressReporter* getProgressReporter() { return &progressReporter; }
 
 private:
-    void renderImage();
+    // Part of the mesh, cached together with the parameters it was built from
+    struct Segment
+    {
+        Mesh mesh;
+        QVector<float> key;
+        bool valid = false;
+    };
+
+    // Builds the heightfield again if the image changed. False if the image
+    // can't be read.
+    bool updateHeightfield();
+    // Moves the surface segment back out of m_Mesh, where generate() put it
+    void reclaimSurface();
+    bool updateSegment(Segment& segment, const QVector<float>& key, const std::function<void()>& build);
+    bool updateFrameSegments();
+    // Packs the frame, hangers and stabilizers with an image surface from
+    // every n-th heightmap sample, n >= 'minStep', into m_PreviewBuffer
+    void packCoarsePreview(int maxTriangles, int minStep);
+    // Both return the number of heightmap vertices, which come first, before
+    // those of the side walls and the backside. 'step' > 1 renders a coarser
+    // grid, for the preview.
+    int renderImage(int step = 1);
+    int renderImageAdaptive();
     void addFrame();
     void addHangers();
     void addStabilizers();
     
-    float getPixel(const QImage &image, const int &x, const int &y)
-    {
-        return image.pixelColor(x, image.height() - 1 - y).red() * depthFactor * -1;
-    }
-
     QVector3D getVertex(float x, float y, float z, const bool scale = false)
     {
         float add = 0.0;
@@ -140,17 +230,26 @@ private:
         xDisplacement = v;
     }
 
+    uint32_t addVertex(const QVector3D& p, bool scale = false)
+    {
+        return m_Mesh.addVertex(getVertex(p.x(), p.y(), p.z(), scale));
+    }
+
     void addTriangle(const QVector3D& p1, const QVector3D& p2, const QVector3D& p3, bool scale = false)
     {
-        m_VerticesData.append(getVertex(p1.x(), p1.y(), p1.z(), scale));
-        m_VerticesData.append(getVertex(p2.x(), p2.y(), p2.z(), scale));
-        m_VerticesData.append(getVertex(p3.x(), p3.y(), p3.z(), scale));
+        const uint32_t i1 = addVertex(p1, scale);
+        const uint32_t i2 = addVertex(p2, scale);
+        const uint32_t i3 = addVertex(p3, scale);
+        m_Mesh.addTriangle(i1, i2, i3);
     }
 
     void addQuad(const QVector3D& p1, const QVector3D& p2, const QVector3D& p3, const QVector3D& p4, bool scale = false)
     {
-        addTriangle(p1, p2, p3, scale);
-        addTriangle(p3, p4, p1, scale);
+        const uint32_t i1 = addVertex(p1, scale);
+        const uint32_t i2 = addVertex(p2, scale);
+        const uint32_t i3 = addVertex(p3, scale);
+        const uint32_t i4 = addVertex(p4, scale);
+        m_Mesh.addQuad(i1, i2, i3, i4);
     }
 
     void addCube(const QVector3D& position, const QVector3D& size, bool scale = false)
@@ -160,6 +259,7 @@ private:
               |    |        |     | 1 |
            p1 *----* p4     |  p1 *----  p2
         */
+        const int firstVertex = m_Mesh.vertexCount();
         QVector3D bp1 = position, bp2, bp3, bp4; // Bottom
         bp2 = {bp1.x()           , bp1.y(), bp1.z() - size.z()};
         bp3 = {bp1.x() + size.x(), bp1.y(), bp1.z() - size.z()};
@@ -177,16 +277,25 @@ private:
         addQuad(tp4, tp3, bp3, bp2, scale); // back
         addQuad(tp1, tp4, bp2, bp1, scale); // left
         addQuad(tp3, tp2, bp4, bp3, scale); // right
+        // A closed box on its own, even where it touches the next one
+        m_Mesh.weldVertices(firstVertex);
     }
     
-    QImage image;
-    QList<QVector3D> m_VerticesData;
+    ImageTiles image;
+    Heightfield heightfield; // Inverted gray values (0-255) of the whole image, scaled to the depth when rendering
+    Segment surface, frame, hangers, stabilizers;
+    Mesh m_Mesh; // All segments combined
+    // After generate(), surface.mesh is empty and its vertices and triangles
+    // are the first ones of m_Mesh instead
+    bool surfaceInMesh = false;
+    int surfaceVertices = 0, surfaceTriangles = 0;
+    int surfaceHeightmapVertices = 0; // The first ones of the surface segment
+    IndexedVertexData m_PreviewBuffer; // m_Mesh, or a coarser version of it, packed for the GPU
 
     float width;
     float totalThickness, minThickness, minThicknessInv;
     float totalHeight;
 
-    float depthFactor = -1.0;
     float widthFactor = -1.0;
     float frameBorder = -1.0;
     uint32_t noOfHangers = 0;
@@ -194,8 +303,12 @@ private:
     bool permanentStabilizers = false;
     float stabilizerHeightFactor = 0.15;
     float stabilizerThreshold = 0;
+    float meshTolerance = 0.0f; // Max. thickness deviation when merging flat areas, 0 disables merging
 
     float xDisplacement = 0.0f;
+    bool imageRendered = false;
+    std::atomic<bool> canceled{false};
+    ProgressReporter progressReporter;
 };
 
 #endif
\ No newline at end of file
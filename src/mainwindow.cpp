@@ -25,12 +25,15 @@
  */
 
 #include <stdio.h>
+#include <algorithm>
 #include <fstream>
+#include <limits>
 
 #include <QtWidgets>
 #include <QSettings>
 #include <QFile>
 #include <QTransform>
+#include <QtConcurrent>
 
 #include "mainwindow.h"
 #include "aboutbox.h"
@@ -38,10 +41,40 @@
 
 extern QSettings *settings;
 
-constexpr int maxSize = 1000;
+// Slider changes within this many milliseconds make one live preview
+static const int LivePreviewDelay = 50;
+// The full mesh follows once the sliders rest this long
+static const int LiveFullDelay = 600;
+// Live previews don't get any coarser than this, however slow
+static const int MinLiveTriangles = 20000;
+
+// File name suffix of the export format chosen in the preferences
+static QString exportSuffix()
+{
+  const QString format = settings->value("export/stlFormat", "binary").toString();
+  if(format == "3mf" || format == "ply" || format == "obj") {
+    return "." + format;
+  }
+  return settings->value("export/compress", false).toBool()? ".stl.gz" : ".stl";
+}
+
+// Replaces the export format suffix of a file name
+static QString withSuffix(const QString &fileName, const QString &suffix)
+{
+  for(const QString known: {".stl.gz", ".stl", ".3mf", ".ply", ".obj"}) {
+    if(fileName.endsWith(known, Qt::CaseInsensitive)) {
+      return fileName.chopped(known.length()) + suffix;
+    }
+  }
+  QFileInfo info(fileName);
+  return info.dir().filePath(info.completeBaseName() + suffix);
+}
 
 MainWindow::MainWindow()
 {
+  renderPool.setMaxThreadCount(1);
+  exportPool.setMaxThreadCount(1);
+
   if(settings->contains("main/windowState")) {
     restoreGeometry(settings->value("main/windowState", "").toByteArray());
   } else {
@@ -69,6 +102,24 @@ MainWindow::MainWindow()
   QLabel *widthLabel = new QLabel(tr("Width, including frame borders (mm):"));
   widthSlider = new Slider("render", "width", 200, 4000, 2000, 10);
 
+  livePreviewTimer = new QTimer(this);
+  livePreviewTimer->setSingleShot(true);
+  livePreviewTimer->setInterval(LivePreviewDelay);
+  connect(livePreviewTimer, &QTimer::timeout, this, [this]() {
+    if(canRenderLive()) requestRender(RenderKind::LivePreview);
+  });
+  liveFullTimer = new QTimer(this);
+  liveFullTimer->setSingleShot(true);
+  liveFullTimer->setInterval(LiveFullDelay);
+  connect(liveFullTimer, &QTimer::timeout, this, [this]() {
+    if(canRenderLive()) requestRender(RenderKind::LiveFull);
+  });
+
+  for(Slider *slider: {minThicknessSlider, totalThicknessSlider, borderSlider, widthSlider}) {
+    connect(slider, &Slider::valueChanged, this, &MainWindow::updateHeightmapPreview);
+    connect(slider, &Slider::valueChanged, this, &MainWindow::scheduleLiveRender);
+  }
+
   QLabel *inputLabel = new QLabel(tr("Input PNG image filename:"));
   inputLineEdit = new QLineEdit(settings->value("main/inputFilePath", "examples/hummingbird.png").toString());
   inputButton = new QPushButton(tr("..."));
@@ -89,6 +140,11 @@ MainWindow::MainWindow()
   connect(renderButton, &QPushButton::clicked, this, &MainWindow::render);
   exportButton = new QPushButton(tr("Export"));
   connect(exportButton, &QPushButton::clicked, this, &MainWindow::exportStl);
+  cancelButton = new QPushButton(tr("Cancel"));
+  cancelButton->setEnabled(false);
+  connect(cancelButton, &QPushButton::clicked, this, &MainWindow::cancelRender);
+  connect(&renderWatcher, &QFutureWatcher<RenderResult>::finished, this, &MainWindow::renderFinished);
+  connect(&exportWatcher, &QFutureWatcher<std::tuple<bool, QString>>::finished, this, &MainWindow::exportFinished);
   
   renderProgress = new QProgressBar(this);
   renderProgress->setRange(0, 100);
@@ -100,6 +156,7 @@ MainWindow::MainWindow()
   QHBoxLayout *buttonsLayout = new QHBoxLayout();
   buttonsLayout->addWidget(renderButton);
   buttonsLayout->addWidget(exportButton);
+  buttonsLayout->addWidget(cancelButton);
 
   QVBoxLayout *layout = new QVBoxLayout();
   layout->addWidget(minThicknessLabel);
@@ -120,13 +177,25 @@ MainWindow::MainWindow()
   layout->addWidget(statusMessage);
   
   preview = new Preview(this);
+  preview->setStatsVisible(settings->value("render/previewStats", false).toBool());
 
   QHBoxLayout *hLayout = new QHBoxLayout();
   hLayout->addLayout(layout, 1);
   setCentralWidget(new QWidget());
   centralWidget()->setLayout(hLayout);
 
-  connect(lithophane.get(), &Lithophane::progress, renderProgress, &QProgressBar::setValue);
+  // Queued when emitted from the render thread
+  ProgressReporter *reporter = lithophane->getProgressReporter();
+  connect(reporter, &ProgressReporter::progress, renderProgress, &QProgressBar::setValue);
+  connect(reporter, &ProgressReporter::status, statusMessage, &QLabel::setText);
+  // A render started during an export takes over the progress bar
+  ProgressReporter *exportReporter = exportLithophane->getProgressReporter();
+  connect(exportReporter, &ProgressReporter::progress, this, [this](int percent) {
+    if(!renderWatcher.isRunning()) renderProgress->setValue(percent);
+  });
+  connect(exportReporter, &ProgressReporter::status, this, [this](const QString &text) {
+    if(!renderWatcher.isRunning()) statusMessage->setText(text);
+  });
 
   show();
 
@@ -136,6 +205,13 @@ MainWindow::MainWindow()
 
 MainWindow::~MainWindow()
 {
+  // A canceled streaming export leaves any earlier file in place. Exports
+  // of a rendered mesh are finished.
+  lithophane->setCanceled(true);
+  exportLithophane->setCanceled(true);
+  renderWatcher.waitForFinished();
+  exportWatcher.waitForFinished();
+
   settings->setValue("main/windowState", saveGeometry());
   settings->setValue("main/inputFilePath", inputLineEdit->text());
   settings->setValue("main/outputFilePath", outputLineEdit->text());
@@ -187,49 +263,20 @@ void MainWindow::showPreferences()
   // Spawn preferences dialog
   ConfigDialog preferences(this);
   preferences.exec();
-}
-
-const QImage MainWindow::getImage()
-{
-  QImageReader imgReader(inputLineEdit->text());
-  imgReader.setAutoTransform(true);
-  QImage image;
-  imgReader.read(&image);
-
-  if(image.width() > maxSize || image.height() > maxSize)
-  {
-    auto message = tr(
-      "The input image is quite large. It is recommended to keep it at a resolution lower or equal to %1x%2 " 
-      "pixels to avoid an unnecessarily complex 3D mesh. Do you want LithoMaker to resize the image before "
-      "processing it?"
-    ).arg(QString::number(maxSize), QString::number(maxSize));
-    // auto response = QMessageBox::question(this, tr("Large image"), message);
-    // if(response == QMessageBox::Yes)
-    {
-      if(image.width() > image.height()) {
-        image = image.scaledToWidth(maxSize);
-      } else {
-        image = image.scaledToHeight(maxSize);
-      }
-    }
+  // Shown on first launch before the preview exists, which then reads the setting itself
+  if(preview != nullptr) {
+    preview->setStatsVisible(settings->value("render/previewStats", false).toBool());
   }
-  if(!image.isGrayscale()) {
-    printf("Converting image to grayscale.\n");
-    image = image.convertToFormat(QImage::Format_Grayscale8);
-  }
-  image.invertPixels();
-
-  return image;
-} 
+}
 
-void MainWindow::render()
+bool MainWindow::checkInput()
 {
   if(!QFileInfo::exists(inputLineEdit->text())) {
     QMessageBox::warning(
       this, tr("File not found"),
       tr("Input file doesn't exist. Please check filename and permissions.")
     );
-    return;
+    return false;
   }
 
   if(settings->value("render/frameBorder").toFloat() * 2 > settings->value("render/width").toFloat()) {
@@ -237,64 +284,350 @@ void MainWindow::render()
       this, tr("Border too thick"),
       tr("The chosen frame border size exceeds the size of the total lithophane width. Please correct this.")
     );
-    return;
+    return false;
   }
 
-  disableUi();
+  return true;
+}
 
-  printf("Rendering STL...\n");
-  const QImage image = getImage();
+bool MainWindow::canRenderLive()
+{
+  // The heightmap shader follows the sliders by itself
+  if(!settings->value("render/liveRender", false).toBool() || settings->value("render/gpuPreview", false).toBool()) {
+    return false;
+  }
+  return QFileInfo::exists(inputLineEdit->text()) &&
+    settings->value("render/frameBorder").toFloat() * 2 < settings->value("render/width").toFloat();
+}
+
+std::function<bool()> MainWindow::configureJob(Lithophane *lithophane, const ImageTiles *image)
+{
+  const QString inputPath = inputLineEdit->text();
+  const ImageTiles openedImage = image != nullptr? *image : ImageTiles();
+
+  // Large images make very complex meshes, so they are scaled down unless asked not to
+  const int maxSize = settings->value("render/limitSize", true).toBool()? settings->value("render/maxSize", 1000).toInt() : 0;
 
   const float width = settings->value("render/width").toFloat();
+  const float totalThickness = settings->value("render/totalThickness").toFloat();
+  const float minThickness = settings->value("render/minThickness").toFloat();
   const float frameBorder = settings->value("render/frameBorder").toFloat();
+  const float frameSlopeFactor = settings->value("render/frameSlopeFactor", "0.75").toFloat();
+  const bool permanentStabilizers = settings->value("render/permanentStabilizers", "false").toBool();
+  const float stabilizerHeightFactor = settings->value("render/stabilizerHeightFactor", 0.15).toFloat();
   const int noOfHangers = settings->value("render/enableHangers", true).toBool()? settings->value("render/hangers").toInt() : 0;
   const float stabilizerThreshold = settings->value("render/enableStabilizers", true).toBool()? settings->value("render/stabilizerThreshold", 60.0f).toFloat() : 0.0f;
-  
+  const float meshTolerance = settings->value("render/adaptiveMeshing", false).toBool()? settings->value("render/meshTolerance", 0.05f).toFloat() : 0.0f;
+
+  return [=]() {
+    // Grayscale conversion and inversion happen when Lithophane builds its heightfield
+    ImageTiles image = openedImage;
+    if(image.isNull() && !image.open(inputPath, maxSize)) {
+      return false;
+    }
+    lithophane->configure(
+      image,
+      width,
+      totalThickness, minThickness,
+      frameBorder, frameSlopeFactor,
+      permanentStabilizers,
+      stabilizerHeightFactor, stabilizerThreshold,
+      noOfHangers,
+      meshTolerance
+    );
+    return true;
+  };
+}
+
+void MainWindow::render()
+{
+  if(!checkInput()) {
+    return;
+  }
+
+  livePreviewTimer->stop();
+  liveFullTimer->stop();
+  requestRender(RenderKind::Full);
+}
+
+void MainWindow::requestRender(RenderKind kind)
+{
+  nextRenderKind = kind;
+
+  // The running render is already outdated, so stop it and start over once it
+  // has finished. Live previews are quick and are shown before the next one.
+  if(renderWatcher.isRunning()) {
+    restartRender = true;
+    if(kind != RenderKind::LivePreview || renderKind != RenderKind::LivePreview) {
+      lithophane->setCanceled(true);
+    }
+    if(kind == RenderKind::Full) {
+      statusMessage->setText("Restarting render...");
+    }
+    return;
+  }
+
+  startRender();
+}
+
+void MainWindow::scheduleLiveRender()
+{
+  if(!canRenderLive()) {
+    return;
+  }
+  // Previews keep coming while the sliders move, the full render waits for a pause
+  if(!livePreviewTimer->isActive()) {
+    livePreviewTimer->start();
+  }
+  liveFullTimer->start();
+}
+
+void MainWindow::startRender()
+{
+  restartRender = false;
+  renderKind = nextRenderKind;
+  // Live renders leave the UI alone, except for exporting the mesh being built
+  if(renderKind == RenderKind::Full) {
+    disableUi();
+    renderButton->setEnabled(true);
+  } else {
+    exportButton->setEnabled(false);
+  }
+  cancelButton->setEnabled(true);
+
+  printf("Rendering STL...\n");
+  statusMessage->setText(renderKind == RenderKind::LivePreview? "Updating preview..." : "Rendering...");
+  renderProgress->setValue(0);
+
+  // Settings are read here on the GUI thread. The render thread only works on the lithophane.
+  auto configure = configureJob(lithophane.get());
+  const bool decimate = settings->value("render/decimate", false).toBool();
+  const int decimateTarget = settings->value("render/decimateTarget", 500000).toInt();
+  const float decimateMaxError = settings->value("render/decimateMaxError", 0.05f).toFloat();
+  const int previewTriangles = settings->value("render/previewTriangles", 1000000).toInt();
+  const bool coarse = renderKind == RenderKind::LivePreview;
+  heightmapPreview = !coarse && settings->value("render/gpuPreview", false).toBool();
+  const bool heightmap = heightmapPreview;
+  heightmapPath = inputLineEdit->text();
+  QImage *grayImage = &heightmapImage;
+  if(liveTriangles == 0) {
+    liveTriangles = previewTriangles;
+  }
+  liveTriangles = std::min(previewTriangles, std::max(liveTriangles, MinLiveTriangles));
+  const int coarseTriangles = liveTriangles;
+  liveRenderTime.start();
+
   lithophane->reset();
-  lithophane->configure(
-    image,
-    width,
-    settings->value("render/totalThickness").toFloat(),
-    settings->value("render/minThickness").toFloat(),
-    frameBorder,
-    settings->value("render/frameSlopeFactor", "0.75").toFloat(),
-    settings->value("render/permanentStabilizers", "false").toBool(),
-    settings->value("render/stabilizerHeightFactor", 0.15).toFloat(),
-    stabilizerThreshold,
-    noOfHangers
-  );
-
-  // Render Lithophane
-  statusMessage->setText("Rendering...");
-  // lithophane->generate();
-  lithophane->uv_sphere(1000, 1000, (float) width / 2.0f);
-  lithophane->uv_sphere(200, 200, (float) (width - 3.0f)  / 2.0f, true);
-  
-  printf("Rendering finished...\n");
-  statusMessage->setText("Rendering finished"); 
+  lithophane->setCanceled(false);
+  Lithophane *lithophane = this->lithophane.get();
+  renderWatcher.setFuture(QtConcurrent::run(&renderPool, [=]() {
+    if(!configure()) {
+      return RenderResult::Unreadable;
+    }
+    // Only the preview's mesh, the full one follows when the sliders rest
+    if(coarse) {
+      if(!lithophane->generatePreview(coarseTriangles)) {
+        return lithophane->isCanceled()? RenderResult::Canceled : RenderResult::Unreadable;
+      }
+      return RenderResult::Finished;
+    }
+    // The graphics card draws the image surface, so only the frame and such become a mesh
+    if(heightmap) {
+      *grayImage = lithophane->getGrayscaleImage();
+      if(grayImage->width() < 2 || grayImage->height() < 2) {
+        return RenderResult::Unreadable;
+      }
+      return lithophane->generateDetails()? RenderResult::Finished : RenderResult::Canceled;
+    }
+    if(!lithophane->generate()) {
+      return lithophane->isCanceled()? RenderResult::Canceled : RenderResult::Unreadable;
+    }
+    if(decimate) {
+      if(!lithophane->decimate(decimateTarget, decimateMaxError)) {
+        return RenderResult::Canceled;
+      }
+    }
+    lithophane->updatePreviewBuffer(previewTriangles);
+    if(lithophane->isCanceled()) {
+      return RenderResult::Canceled;
+    }
+    return RenderResult::Finished;
+  }));
+}
+
+void MainWindow::renderFinished()
+{
+  if(restartRender && (renderKind != RenderKind::LivePreview || renderWatcher.result() != RenderResult::Finished)) {
+    startRender();
+    return;
+  }
 
-  QList<QVector3D> data = lithophane->getVertices();
-  preview->loadData(data);
-  preview->setCameraPosition(QVector3D(0.0f, (float)lithophane->getHeight() * 0.45f, (float)width * 1.75f));
+  switch(renderWatcher.result()) {
+  case RenderResult::Finished:
+    printf("Rendering finished...\n");
+    if(heightmapPreview) {
+      preview->loadHeightmap(heightmapImage, settings->value("render/previewTriangles", 1000000).toInt());
+      updateHeightmapPreview();
+    } else {
+      preview->loadVertexBuffer(lithophane->takePreviewBuffer());
+    }
+    if(renderKind == RenderKind::LivePreview) {
+      statusMessage->setText("Preview updated");
+      // The time taken mostly grows with the triangles, so the next preview
+      // gets as many as fit in the time allowed
+      const double budget = settings->value("render/liveRenderBudget", 100).toDouble();
+      const double factor = std::clamp(budget / std::max<qint64>(liveRenderTime.elapsed(), 1), 0.1, 2.0);
+      liveTriangles = (int)std::min(liveTriangles * factor, (double)std::numeric_limits<int>::max());
+    } else {
+      statusMessage->setText("Rendering finished");
+    }
+    if(renderKind == RenderKind::Full) {
+      preview->setCameraPosition(QVector3D(0.0f, (float)lithophane->getHeight() * 0.45f, (float)lithophane->getWidth() * 1.75f));
+    }
+    break;
+  case RenderResult::Canceled:
+    printf("Rendering canceled...\n");
+    lithophane->reset();
+    statusMessage->setText("Rendering canceled");
+    renderProgress->setValue(0);
+    break;
+  case RenderResult::Unreadable:
+    lithophane->reset();
+    statusMessage->setText("Ready");
+    renderProgress->setValue(0);
+    // Not again and again while the sliders move
+    if(renderKind == RenderKind::Full) {
+      QMessageBox::warning(
+        this, tr("Unreadable image"),
+        tr("Input file couldn't be read as an image. Please check that it is a PNG or JPG image.")
+      );
+    }
+    break;
+  }
+  // Uploaded to the graphics card by now, if at all
+  heightmapImage = QImage();
 
+  if(restartRender) {
+    startRender();
+    return;
+  }
   enableUi();
 }
 
+void MainWindow::updateHeightmapPreview()
+{
+  // A running render shows the latest values once it has finished. A new
+  // input file waits for the next render, the texture is of the last one.
+  if(!preview->isShowingHeightmap() || renderWatcher.isRunning() || inputLineEdit->text() != heightmapPath) {
+    return;
+  }
+
+  const float width = settings->value("render/width").toFloat();
+  const float totalThickness = settings->value("render/totalThickness").toFloat();
+  const float minThickness = settings->value("render/minThickness").toFloat();
+  const float frameBorder = settings->value("render/frameBorder").toFloat();
+  if(frameBorder * 2 >= width) {
+    return;
+  }
+
+  // Only the frame, hangers and stabilizers are meshes, which takes no time
+  lithophane->setCanceled(false);
+  // The image the texture was made from, not opened again
+  const ImageTiles image = lithophane->getImage();
+  if(!configureJob(lithophane.get(), &image)() || !lithophane->generateDetails()) {
+    return;
+  }
+  preview->updateHeightmap(width, totalThickness, minThickness, frameBorder, lithophane->getMesh().indexedVertexData());
+}
+
+void MainWindow::cancelRender()
+{
+  restartRender = false;
+  livePreviewTimer->stop();
+  liveFullTimer->stop();
+  lithophane->setCanceled(true);
+  statusMessage->setText("Canceling...");
+}
+
 void MainWindow::exportStl()
 { 
-  disableUi();
+  if(exportWatcher.isRunning()) {
+    return;
+  }
+
+  const QString format = settings->value("export/stlFormat", "binary").toString();
+  const bool overwrite = settings->value("export/alwaysOverwrite", false).toBool();
+  const bool streaming = settings->value("export/streaming", false).toBool() && format == "binary";
+  // After a render for the heightmap shader or a live preview, the image
+  // surface is only meshed for the export
+  const bool meshing = !streaming && !lithophane->isImageRendered() && !lithophane->getMesh().isEmpty();
+  const bool decimate = settings->value("render/decimate", false).toBool();
+  const int decimateTarget = settings->value("render/decimateTarget", 500000).toInt();
+  const float decimateMaxError = settings->value("render/decimateMaxError", 0.05f).toFloat();
+
+  // Streaming goes straight from the input image to the file and needs no render beforehand
+  if((streaming || meshing) && !checkInput()) {
+    return;
+  }
+
+  // The output file name follows the chosen format
+  const QString suffix = exportSuffix();
+  if(!outputLineEdit->text().endsWith(suffix, Qt::CaseInsensitive)) {
+    outputLineEdit->setText(withSuffix(outputLineEdit->text(), suffix));
+  }
+
+  QByteArray printSettings;
+  if(format == "3mf" && settings->value("export/embedPrintSettings", true).toBool()) {
+    QFile iniFile(":lithophane.ini");
+    if(iniFile.open(QIODevice::ReadOnly)) {
+      printSettings = iniFile.readAll();
+    }
+  }
 
+  exportButton->setEnabled(false);
   statusMessage->setText("Saving to file...");
   renderProgress->setValue(0);
-  auto [ok, message] = lithophane->saveToStl(
-    outputLineEdit->text(),
-    settings->value("export/stlFormat", "binary").toString(),
-    settings->value("export/alwaysOverwrite", false).toBool()
-  );
-  renderProgress->setValue(ok? 100 : 0);
-  statusMessage->setText(message);
 
-  enableUi();
+  // The export thread works on a snapshot of the rendered mesh, or on its own
+  // lithophane when streaming or meshing, so the UI stays free for the next render
+  const QString path = outputLineEdit->text();
+  Lithophane *exporter = exportLithophane.get();
+  exporter->setCanceled(false);
+  if(streaming) {
+    auto configure = configureJob(exporter);
+    exportWatcher.setFuture(QtConcurrent::run(&exportPool, [=]() -> std::tuple<bool, QString> {
+      if(!configure()) {
+        return {false, tr("Input file couldn't be read as an image. Please check that it is a PNG or JPG image.")};
+      }
+      return exporter->generateToStl(path, overwrite);
+    }));
+  } else if(meshing) {
+    auto configure = configureJob(exporter);
+    exportWatcher.setFuture(QtConcurrent::run(&exportPool, [=]() -> std::tuple<bool, QString> {
+      if(!configure()) {
+        return {false, tr("Input file couldn't be read as an image. Please check that it is a PNG or JPG image.")};
+      }
+      if(!exporter->generate() || (decimate && !exporter->decimate(decimateTarget, decimateMaxError))) {
+        return {false, tr("The export was canceled.")};
+      }
+      return exporter->saveToStl(path, format, overwrite, printSettings);
+    }));
+  } else {
+    std::shared_ptr<const Mesh> mesh = lithophane->getMeshSnapshot();
+    exportWatcher.setFuture(QtConcurrent::run(&exportPool, [=]() {
+      return exporter->saveToStl(*mesh, path, format, overwrite, printSettings);
+    }));
+  }
+}
+
+void MainWindow::exportFinished()
+{
+  auto [ok, message] = exportWatcher.result();
+  if(!renderWatcher.isRunning()) {
+    renderProgress->setValue(ok? 100 : 0);
+    exportButton->setEnabled(true);
+  }
+  statusMessage->setText(message);
 }
 
 void MainWindow::inputSelect()
@@ -309,10 +642,11 @@ void MainWindow::inputSelect()
 void MainWindow::outputSelect()
 {
   auto path = QFileInfo(outputLineEdit->text()).absolutePath();
-  QString selectedFile = QFileDialog::getSaveFileName(this, tr("Enter output file"), path, "STL 3D Model (*.stl)");
+  const QString suffix = exportSuffix();
+  QString selectedFile = QFileDialog::getSaveFileName(this, tr("Enter output file"), path, QString("%1 3D Model (*%2)").arg(suffix.section('.', 1, 1).toUpper(), suffix));
   if(selectedFile != QByteArray()) {
-    if(selectedFile.right(4).toLower() != ".stl") {
-      selectedFile.append(".stl");
+    if(selectedFile.right(suffix.length()).toLower() != suffix) {
+      selectedFile.append(suffix);
     }
     outputLineEdit->setText(selectedFile);
   }
@@ -323,6 +657,8 @@ void MainWindow::enableUi()
   inputButton->setEnabled(true);
   outputButton->setEnabled(true);
   renderButton->setEnabled(true);
+  exportButton->setEnabled(!exportWatcher.isRunning());
+  cancelButton->setEnabled(false);
 }
 
 void MainWindow::disableUi()
@@ -330,4 +666,5 @@ void MainWindow::disableUi()
   inputButton->setEnabled(false);
   outputButton->setEnabled(false);
   renderButton->setEnabled(false);
+  exportButton->setEnabled(false);
 }
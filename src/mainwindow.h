@@ -27,6 +27,7 @@
 #ifndef __MAINWINDOW_H__
 #define __MAINWINDOW_H__
 
+#include <functional>
 #include <memory>
 
 #include <QMainWindow>
@@ -38,6 +39,10 @@
 #include <QPushButton>
 #include <QLabel>
 #include <QEntity>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QThreadPool>
+#include <QTimer>
 
 #include "slider.h"
 #include "lithophane.h"
@@ -65,6 +70,13 @@ private slots:
   void showPreferences();
   void inputSelect();
   void outputSelect();
+  void renderFinished();
+  void cancelRender();
+  void exportFinished();
+  // Follows the sliders while the preview draws the image on the graphics card
+  void updateHeightmapPreview();
+  // Restarts the live render timers when the sliders move, if enabled
+  void scheduleLiveRender();
   
 private:
   void enableUi();
@@ -72,7 +84,23 @@ private:
   void createActions();
   void createMenus();
 
-  const QImage getImage();
+  enum class RenderResult { Finished, Canceled, Unreadable };
+  // Full renders are started by the Render button. Live renders follow the
+  // sliders: a coarse preview while they move, then the full mesh once they
+  // rest, both keeping the camera where it is.
+  enum class RenderKind { Full, LivePreview, LiveFull };
+
+  bool checkInput();
+  // Reads the render settings and returns a job configuring 'lithophane'
+  // with them, which may run on any thread. Fails if the image is unreadable.
+  // Uses 'image' when given instead of opening the input file again.
+  std::function<bool()> configureJob(Lithophane *lithophane, const ImageTiles *image = nullptr);
+  // Cancels a running render, which restarts as 'kind' once it has finished.
+  // A running live preview is left to finish when another one follows.
+  void requestRender(RenderKind kind);
+  void startRender();
+  // Same as checkInput(), but quietly as the sliders move
+  bool canRenderLive();
 
   //QByteArray stlString;
   Slider *minThicknessSlider;
@@ -88,6 +116,7 @@ private:
   QPushButton *outputButton;
   QPushButton *renderButton;
   QPushButton *exportButton;
+  QPushButton *cancelButton;
   QLineEdit *outputLineEdit;
   QProgressBar *renderProgress;
   QLabel* statusMessage;
@@ -99,8 +128,34 @@ private:
   QMenu *helpMenu;
   QMenuBar *menuBar;
 
-  Preview* preview;
+  Preview* preview = nullptr;
+  // Renders and exports each get a thread of their own rather than one of
+  // the global pool, which their steps fill with parallel work
+  QThreadPool renderPool;
+  QThreadPool exportPool;
   std::unique_ptr<Lithophane> lithophane = std::make_unique<Lithophane>();
+  QFutureWatcher<RenderResult> renderWatcher;
+  bool restartRender = false;
+  // Of the running and of the next render
+  RenderKind renderKind = RenderKind::Full;
+  RenderKind nextRenderKind = RenderKind::Full;
+  // Coalesces slider changes into live previews, and starts the full render
+  // once the sliders pause
+  QTimer *livePreviewTimer;
+  QTimer *liveFullTimer;
+  // Triangles of the next live preview, adjusted to the time allowed for it
+  int liveTriangles = 0;
+  QElapsedTimer liveRenderTime;
+  // The running or last render only built the frame and such, with the
+  // image surface left to the heightmap shader
+  bool heightmapPreview = false;
+  QImage heightmapImage;
+  // Input file of the image uploaded for the heightmap shader
+  QString heightmapPath;
+  // Exports run on their own lithophane, so renders can start while the
+  // previous export is still being written
+  std::unique_ptr<Lithophane> exportLithophane = std::make_unique<Lithophane>();
+  QFutureWatcher<std::tuple<bool, QString>> exportWatcher;
 };
 
 #endif // __MAINWINDOW_H__
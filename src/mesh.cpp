@@ -0,0 +1,299 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <QtConcurrent>
+
+#include "vertexcache.h"
+
+
+namespace {
+
+// Triangles per block of the normals kernel, few enough for the unpacked
+// coordinates to stay in the L1 cache
+constexpr int normalsBlockSize = 256;
+
+// Triangles per task of computeNormals()
+constexpr int normalsPerTask = 1 << 16;
+
+// Position and normal of each vertex in indexedVertexData()
+constexpr int floatsPerVertex = 3 + 3;
+
+// Vertices per task of indexedVertexData()
+constexpr int packedPerTask = 1 << 16;
+
+// Faces more than 60 degrees apart meet in a sharp edge
+constexpr float creaseCosine = 0.5f;
+
+// QByteArray holds a little less than 2 GB
+constexpr qint64 maxBufferSize = 2000000000;
+
+}
+
+void Mesh::clear()
+{
+    vertices.clear();
+    indices.clear();
+    normals.clear();
+}
+
+void Mesh::reserve(int noOfVertices, int noOfTriangles)
+{
+    vertices.reserve(noOfVertices);
+    indices.reserve(noOfTriangles * 3);
+}
+
+void Mesh::resize(int noOfVertices, int noOfTriangles)
+{
+    vertices.resize(noOfVertices);
+    indices.resize(noOfTriangles * 3);
+    normals.clear();
+}
+
+void Mesh::truncate(int noOfVertices, int noOfTriangles)
+{
+    vertices.resize(noOfVertices);
+    indices.resize(noOfTriangles * 3);
+    if (normals.count() > noOfTriangles) normals.resize(noOfTriangles);
+}
+
+void Mesh::append(const Mesh& other)
+{
+    const uint32_t offset = vertices.count();
+
+    if (hasNormals() && other.hasNormals()) normals.append(other.normals);
+    else normals.clear();
+
+    vertices.append(other.vertices);
+    indices.reserve(indices.count() + other.indices.count());
+    for (uint32_t index : other.indices)
+    {
+        indices.append(index + offset);
+    }
+}
+
+void Mesh::weldVertices(int firstVertex)
+{
+    const int noOfVertices = vertices.count();
+    auto less = [this](int a, int b) {
+        const QVector3D& p = vertices.at(a);
+        const QVector3D& q = vertices.at(b);
+        if (p.x() != q.x()) return p.x() < q.x();
+        if (p.y() != q.y()) return p.y() < q.y();
+        return p.z() < q.z();
+    };
+    // Stable, so each run of equal positions starts with its first vertex
+    QVector<int> order(noOfVertices - firstVertex);
+    std::iota(order.begin(), order.end(), firstVertex);
+    std::stable_sort(order.begin(), order.end(), less);
+    QVector<int> first(noOfVertices);
+    std::iota(first.begin(), first.begin() + firstVertex, 0);
+    for (int i = 0; i < order.count(); ++i)
+    {
+        first[order[i]] = (i > 0 && !less(order[i - 1], order[i])) ? first[order[i - 1]] : order[i];
+    }
+
+    // The vertices kept stay in their order
+    QVector<uint32_t> renumbered(noOfVertices);
+    QVector<QVector3D> welded;
+    welded.reserve(noOfVertices);
+    for (int v = 0; v < noOfVertices; ++v)
+    {
+        if (first[v] != v) continue;
+        renumbered[v] = welded.count();
+        welded.append(vertices.at(v));
+    }
+    for (uint32_t& index : indices)
+    {
+        index = renumbered[first[index]];
+    }
+    vertices = welded;
+}
+
+void Mesh::computeNormals()
+{
+    const int noOfTriangles = triangleCount();
+    normals.resize(noOfTriangles);
+
+    QVector<int> tasks;
+    for (int first = 0; first < noOfTriangles; first += normalsPerTask)
+    {
+        tasks.append(first);
+    }
+    const QVector3D *vertexData = vertices.constData();
+    const uint32_t *indexData = indices.constData();
+    QVector3D *normalData = normals.data();
+    QtConcurrent::blockingMap(tasks, [=](int first) {
+        computeNormals(vertexData, indexData + first * 3, std::min(normalsPerTask, noOfTriangles - first), normalData + first);
+    });
+}
+
+void Mesh::computeNormals(const QVector3D* vertices, const uint32_t* indices, int noOfTriangles, QVector3D* normals)
+{
+    // The edges of a block of triangles are gathered into separate arrays, so
+    // the arithmetic runs over plain arrays the compiler can vectorize
+    float ux[normalsBlockSize], uy[normalsBlockSize], uz[normalsBlockSize];
+    float vx[normalsBlockSize], vy[normalsBlockSize], vz[normalsBlockSize];
+    float nx[normalsBlockSize], ny[normalsBlockSize], nz[normalsBlockSize];
+
+    for (int first = 0; first < noOfTriangles; first += normalsBlockSize)
+    {
+        const int count = std::min(normalsBlockSize, noOfTriangles - first);
+        const uint32_t *triangle = indices + first * 3;
+        for (int i = 0; i < count; ++i, triangle += 3)
+        {
+            const QVector3D &p1 = vertices[triangle[0]];
+            const QVector3D u = vertices[triangle[1]] - p1;
+            const QVector3D v = vertices[triangle[2]] - p1;
+            ux[i] = u.x(); uy[i] = u.y(); uz[i] = u.z();
+            vx[i] = v.x(); vy[i] = v.y(); vz[i] = v.z();
+        }
+
+        // Same steps as QVector3D::crossProduct() and normalized(), including
+        // the double precision length, so exported files don't change
+        for (int i = 0; i < count; ++i)
+        {
+            const float x = uy[i] * vz[i] - uz[i] * vy[i];
+            const float y = uz[i] * vx[i] - ux[i] * vz[i];
+            const float z = ux[i] * vy[i] - uy[i] * vx[i];
+            const double length = double(x) * double(x) + double(y) * double(y) + double(z) * double(z);
+            const double root = std::sqrt(length);
+            const bool unit = std::abs(length - 1.0) <= 1e-12;
+            const bool null = std::abs(length) <= 1e-12;
+            // Selects rather than branches, so every lane divides
+            const double divisor = (unit | null) ? 1.0 : root;
+            const float scaledX = float(double(x) / divisor);
+            const float scaledY = float(double(y) / divisor);
+            const float scaledZ = float(double(z) / divisor);
+            nx[i] = null ? 0.0f : scaledX;
+            ny[i] = null ? 0.0f : scaledY;
+            nz[i] = null ? 0.0f : scaledZ;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            normals[first + i] = QVector3D(nx[i], ny[i], nz[i]);
+        }
+    }
+}
+
+IndexedVertexData Mesh::indexedVertexData() const
+{
+    const int noOfTriangles = triangleCount();
+    const int noOfVertices = vertexCount();
+    const int noOfCorners = noOfTriangles * 3;
+
+    QVector<QVector3D> faceNormals = normals;
+    if (!hasNormals())
+    {
+        faceNormals.resize(noOfTriangles);
+        computeNormals(vertices.constData(), indices.constData(), noOfTriangles, faceNormals.data());
+    }
+
+    // Corners around each vertex
+    QVector<int> offsets(noOfVertices + 1, 0);
+    for (uint32_t v : indices)
+    {
+        ++offsets[v + 1];
+    }
+    for (int v = 0; v < noOfVertices; ++v)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    QVector<int> corners(noOfCorners);
+    QVector<int> filled = offsets;
+    for (int c = 0; c < noOfCorners; ++c)
+    {
+        corners[filled[indices.at(c)]++] = c;
+    }
+
+    QVector<int> tasks;
+    for (int first = 0; first < noOfVertices; first += packedPerTask)
+    {
+        tasks.append(first);
+    }
+
+    // The corners of a vertex are grouped by the direction of their faces.
+    // 'firstVertex' becomes the first buffer vertex of each mesh vertex.
+    QVector<int> group(noOfCorners);
+    QVector<int> firstVertex(noOfVertices + 1, 0);
+    QtConcurrent::blockingMap(tasks, [&](int first) {
+        const int last = std::min(packedPerTask, noOfVertices - first) + first;
+        QVector<QVector3D> seeds;
+        for (int v = first; v < last; ++v)
+        {
+            seeds.clear();
+            for (int i = offsets[v]; i < offsets[v + 1]; ++i)
+            {
+                const QVector3D &normal = faceNormals.at(corners[i] / 3);
+                int g = 0;
+                while (g < seeds.count() && QVector3D::dotProduct(seeds.at(g), normal) < creaseCosine) ++g;
+                // Degenerate triangles join any group
+                if (g == seeds.count() && normal.isNull() && g > 0) g = 0;
+                else if (g == seeds.count()) seeds.append(normal);
+                group[corners[i]] = g;
+            }
+            firstVertex[v + 1] = seeds.count();
+        }
+    });
+    for (int v = 0; v < noOfVertices; ++v)
+    {
+        firstVertex[v + 1] += firstVertex[v];
+    }
+    const int noOfBufferVertices = firstVertex[noOfVertices];
+    if ((qint64)noOfBufferVertices * floatsPerVertex * sizeof(float) > maxBufferSize ||
+        (qint64)noOfCorners * sizeof(uint32_t) > maxBufferSize)
+    {
+        return IndexedVertexData();
+    }
+
+    IndexedVertexData data;
+    data.indices.resize(noOfCorners * sizeof(uint32_t));
+    uint32_t *outIndices = reinterpret_cast<uint32_t *>(data.indices.data());
+    for (int c = 0; c < noOfCorners; ++c)
+    {
+        outIndices[c] = firstVertex[indices.at(c)] + group[c];
+    }
+    optimizeVertexCache(outIndices, noOfTriangles, noOfBufferVertices);
+
+    // Numbered in the order they are drawn, so vertex fetches move forward
+    // through the buffer as well
+    QVector<int> position(noOfBufferVertices, -1);
+    int next = 0;
+    for (int c = 0; c < noOfCorners; ++c)
+    {
+        int &p = position[outIndices[c]];
+        if (p < 0) p = next++;
+        outIndices[c] = p;
+    }
+
+    data.vertices.resize(noOfBufferVertices * floatsPerVertex * sizeof(float));
+    float *outVertices = reinterpret_cast<float *>(data.vertices.data());
+    QtConcurrent::blockingMap(tasks, [&](int first) {
+        const int last = std::min(packedPerTask, noOfVertices - first) + first;
+        QVector<QVector3D> sums;
+        for (int v = first; v < last; ++v)
+        {
+            sums.fill(QVector3D(), firstVertex[v + 1] - firstVertex[v]);
+            for (int i = offsets[v]; i < offsets[v + 1]; ++i)
+            {
+                sums[group[corners[i]]] += faceNormals.at(corners[i] / 3);
+            }
+            const QVector3D &p = vertices.at(v);
+            for (int g = 0; g < sums.count(); ++g)
+            {
+                const QVector3D normal = sums.at(g).normalized();
+                float *out = outVertices + (qint64)position[firstVertex[v] + g] * floatsPerVertex;
+                out[0] = p.x();
+                out[1] = p.y();
+                out[2] = p.z();
+                out[3] = normal.x();
+                out[4] = normal.y();
+                out[5] = normal.z();
+            }
+        }
+    });
+    return data;
+}
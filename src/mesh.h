@@ -0,0 +1,102 @@
+#ifndef __MESH_H__
+#define __MESH_H__
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QVector>
+#include <QVector3D>
+
+
+// Shared vertices as interleaved position and normal floats, and three
+// 32-bit indices into them per triangle
+struct IndexedVertexData
+{
+    QByteArray vertices;
+    QByteArray indices;
+};
+
+// Indexed triangle mesh: a shared vertex buffer plus a 32-bit index buffer
+// holding three vertex indices per triangle. The flat normal of every
+// triangle can be computed once and kept alongside, for the preview and the
+// exporters to share.
+class Mesh
+{
+public:
+    void clear();
+    void reserve(int noOfVertices, int noOfTriangles);
+    void resize(int noOfVertices, int noOfTriangles);
+    // Drops all but the first vertices and triangles, keeping their normals
+    void truncate(int noOfVertices, int noOfTriangles);
+    void append(const Mesh& other);
+    // Makes vertices from 'firstVertex' on at exactly the same position one,
+    // so triangles built corner by corner share their edges. Earlier vertices,
+    // the triangles and their normals stay as they are.
+    void weldVertices(int firstVertex = 0);
+
+    // Fills 'normals' for all triangles, in parallel
+    void computeNormals();
+    // Normals of 'noOfTriangles' triangles, exactly as QVector3D::normal() gives them
+    static void computeNormals(const QVector3D* vertices, const uint32_t* indices, int noOfTriangles, QVector3D* normals);
+
+    // Vertex and index buffers ready to upload to the GPU as they are. Around
+    // each vertex, faces less than 60 degrees apart share one buffer vertex
+    // with their mean normal, so surfaces are shaded smoothly while the
+    // frame and wall edges stay sharp. Triangles are ordered for the vertex
+    // cache and vertices by first use. Empty if the mesh is too large for
+    // one QByteArray.
+    IndexedVertexData indexedVertexData() const;
+
+    uint32_t addVertex(const QVector3D& vertex)
+    {
+        vertices.append(vertex);
+        return vertices.count() - 1;
+    }
+
+    void addTriangle(uint32_t i1, uint32_t i2, uint32_t i3)
+    {
+        indices.append(i1);
+        indices.append(i2);
+        indices.append(i3);
+    }
+
+    // Same winding as the triangle soup helpers: (i1, i2, i3) and (i3, i4, i1)
+    void addQuad(uint32_t i1, uint32_t i2, uint32_t i3, uint32_t i4)
+    {
+        addTriangle(i1, i2, i3);
+        addTriangle(i3, i4, i1);
+    }
+
+    // Raw variant of addQuad() for generators filling a resized mesh in parallel.
+    // Returns the position following the written indices.
+    static uint32_t* putQuad(uint32_t* out, uint32_t i1, uint32_t i2, uint32_t i3, uint32_t i4)
+    {
+        out[0] = i1; out[1] = i2; out[2] = i3;
+        out[3] = i3; out[4] = i4; out[5] = i1;
+        return out + 6;
+    }
+
+    bool isEmpty() const { return indices.isEmpty(); }
+    int vertexCount() const { return vertices.count(); }
+    int triangleCount() const { return indices.count() / 3; }
+    // False once triangles were added or changed after computeNormals()
+    bool hasNormals() const { return normals.count() == triangleCount(); }
+
+    const QVector3D& vertex(int triangle, int corner) const
+    {
+        return vertices.at(indices.at(triangle * 3 + corner));
+    }
+
+    // The kept normal of a triangle, or the same computed on the spot
+    QVector3D normal(int triangle) const
+    {
+        if (hasNormals()) return normals.at(triangle);
+        return QVector3D::normal(vertex(triangle, 0), vertex(triangle, 1), vertex(triangle, 2));
+    }
+
+    QVector<QVector3D> vertices;
+    QVector<uint32_t> indices;
+    QVector<QVector3D> normals; // One per triangle
+};
+
+#endif
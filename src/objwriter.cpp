@@ -0,0 +1,72 @@
+#include "objwriter.h"
+
+#include <charconv>
+#include <cstring>
+
+#include <QFile>
+
+#include "chunkwriter.h"
+
+
+namespace {
+
+// Longest line putVertex() or putFace() writes, with numbers of at most 16 characters
+constexpr int maxLineSize = 3 * 16 + 8;
+
+// Shortest text reading back as the same float
+char* putVertex(char* out, const QVector3D& v)
+{
+    *out++ = 'v';
+    for (int i = 0; i < 3; ++i)
+    {
+        *out++ = ' ';
+        out = std::to_chars(out, out + 16, v[i]).ptr;
+    }
+    *out++ = '\n';
+    return out;
+}
+
+// OBJ counts vertices from 1
+char* putFace(char* out, const uint32_t* indices)
+{
+    *out++ = 'f';
+    for (int i = 0; i < 3; ++i)
+    {
+        *out++ = ' ';
+        out = std::to_chars(out, out + 16, (quint64)indices[i] + 1).ptr;
+    }
+    *out++ = '\n';
+    return out;
+}
+
+}
+
+bool writeObj(const QString& path, const Mesh& mesh, const std::function<void(int)>& progress)
+{
+    const int noOfVertices = mesh.vertexCount();
+    const int noOfTriangles = mesh.triangleCount();
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    bool ok = file.write("# LithoMaker\no lithophane\n") == 26;
+
+    const auto output = [&file](const char* data, qint64 size) { return file.write(data, size) == size; };
+    const auto reportProgress = [&progress, noOfVertices, noOfTriangles](int done) {
+        if (progress) progress((int)((float)done / (float)(noOfVertices + noOfTriangles) * 100.0f));
+    };
+
+    ChunkWriter writer(maxLineSize);
+    ok = ok && writer.write(
+        noOfVertices,
+        [&mesh](char* out, int i) { return putVertex(out, mesh.vertices.at(i)); },
+        output, reportProgress
+    );
+    ok = ok && writer.write(
+        noOfTriangles,
+        [&mesh](char* out, int t) { return putFace(out, mesh.indices.constData() + t * 3); },
+        output, [&reportProgress, noOfVertices](int done) { reportProgress(noOfVertices + done); }
+    );
+
+    file.close();
+    return ok && file.error() == QFileDevice::NoError;
+}
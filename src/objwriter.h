@@ -0,0 +1,16 @@
+#ifndef __OBJWRITER_H__
+#define __OBJWRITER_H__
+
+#include <functional>
+
+#include <QString>
+
+#include "mesh.h"
+
+
+// Writes a mesh as Wavefront OBJ: one 'v' line per shared vertex and one 'f'
+// line per triangle indexing them. 'progress' gets 0 - 100% from the calling
+// thread.
+bool writeObj(const QString& path, const Mesh& mesh, const std::function<void(int)>& progress = nullptr);
+
+#endif
@@ -0,0 +1,145 @@
+#include "pipelinewriter.h"
+
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include <zlib.h>
+
+
+namespace {
+
+// Deflate looks back at most this far, so priming a block with more of the
+// previous one doesn't help
+constexpr int dictionarySize = 32 * 1024;
+
+// Member header without name or modification time, for reproducible files
+const char gzipHeader[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+
+// Empty final block with fixed codes, ending the deflate stream after the
+// byte aligned blocks written by Z_SYNC_FLUSH
+const char finalBlock[] = {3, 0};
+
+}
+
+PipelineWriter::PipelineWriter(int queueCapacity) :
+    m_Queue(queueCapacity)
+{
+    m_WriterPool.setMaxThreadCount(1);
+}
+
+PipelineWriter::~PipelineWriter()
+{
+    if (m_Open) close();
+}
+
+bool PipelineWriter::open(const QString& path, bool compress)
+{
+    m_Compress = compress;
+    m_Dictionary.clear();
+    m_File.setFileName(path);
+    if (!m_File.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    if (compress && m_File.write(gzipHeader, sizeof(gzipHeader)) != sizeof(gzipHeader))
+    {
+        m_File.close();
+        return false;
+    }
+
+    m_Open = true;
+    m_Writer = QtConcurrent::run(&m_WriterPool, [this]() {
+        bool ok = true;
+        uint32_t crc = crc32(0L, Z_NULL, 0);
+        quint64 size = 0;
+        Block block;
+        while (m_Queue.pop(block))
+        {
+            // Keep draining after a failure so the producer never blocks forever
+            if (m_Compress)
+            {
+                // Runs the deflate task right here if no pool thread has started it yet
+                const Deflated deflated = block.deflated.result();
+                if (ok) ok = m_File.write(deflated.data) == deflated.data.size();
+                crc = crc32_combine(crc, deflated.crc, deflated.size);
+                size += deflated.size;
+            }
+            else if (ok)
+            {
+                ok = m_File.write(block.data) == block.data.size();
+            }
+        }
+
+        if (ok && m_Compress)
+        {
+            char trailer[2 * sizeof(uint32_t)];
+            qToLittleEndian(crc, trailer);
+            qToLittleEndian((uint32_t)size, trailer + sizeof(uint32_t)); // Size modulo 4 GB
+            ok = m_File.write(finalBlock, sizeof(finalBlock)) == sizeof(finalBlock) &&
+                m_File.write(trailer, sizeof(trailer)) == sizeof(trailer);
+        }
+        return ok;
+    });
+    return true;
+}
+
+void PipelineWriter::write(QByteArray data)
+{
+    if (data.isEmpty()) return;
+
+    Block block;
+    if (m_Compress)
+    {
+        const QByteArray dictionary = m_Dictionary;
+        m_Dictionary = data.right(dictionarySize);
+        block.deflated = QtConcurrent::run([data, dictionary]() { return deflateBlock(data, dictionary); });
+    }
+    else
+    {
+        block.data = std::move(data);
+    }
+    m_Queue.push(std::move(block));
+}
+
+bool PipelineWriter::close()
+{
+    if (!m_Open) return false;
+    m_Open = false;
+
+    m_Queue.close();
+    const bool ok = m_Writer.result();
+    m_File.close();
+    return ok && m_File.error() == QFileDevice::NoError;
+}
+
+PipelineWriter::Deflated PipelineWriter::deflateBlock(const QByteArray& data, const QByteArray& dictionary)
+{
+    Deflated deflated;
+    deflated.crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)data.constData(), data.size());
+    deflated.size = data.size();
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    if (!dictionary.isEmpty())
+    {
+        deflateSetDictionary(&stream, (const Bytef*)dictionary.constData(), dictionary.size());
+    }
+
+    // Room for incompressible data plus the sync flush marker
+    deflated.data.resize(deflateBound(&stream, data.size()) + 16);
+    stream.next_in = (Bytef*)data.constData();
+    stream.avail_in = data.size();
+    qint64 produced = 0;
+    for (;;)
+    {
+        stream.next_out = (Bytef*)deflated.data.data() + produced;
+        stream.avail_out = deflated.data.size() - produced;
+        deflate(&stream, Z_SYNC_FLUSH);
+        produced = deflated.data.size() - stream.avail_out;
+        if (stream.avail_out != 0) break;
+        deflated.data.resize(deflated.data.size() * 2);
+    }
+    deflated.data.resize(produced);
+    deflateEnd(&stream);
+    return deflated;
+}
@@ -0,0 +1,65 @@
+#ifndef __PIPELINEWRITER_H__
+#define __PIPELINEWRITER_H__
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QFile>
+#include <QFuture>
+#include <QString>
+#include <QThreadPool>
+
+#include "boundedqueue.h"
+
+
+// Writes blocks of data to a file from a background thread while the caller
+// produces the next ones. With compression on, the file is gzip compressed:
+// each block is deflated on the thread pool as soon as it is queued, primed
+// with the end of the block before it, and the writer thread joins them into a
+// single gzip stream. The output only depends on the blocks written, not on
+// the number of threads. The writer thread comes from a pool of its own, so
+// callers on the global pool never wait for a global pool thread to start it.
+class PipelineWriter
+{
+public:
+    // At most 'queueCapacity' blocks are compressed or wait for the disk at any time
+    explicit PipelineWriter(int queueCapacity = 8);
+    ~PipelineWriter();
+
+    bool open(const QString& path, bool compress = false);
+    bool isCompressed() const { return m_Compress; }
+
+    // Queues a block, blocking while the queue is full
+    void write(QByteArray data);
+
+    // Waits until all queued blocks are written and ends the gzip stream.
+    // Returns false if the file could not be written completely.
+    bool close();
+
+private:
+    struct Deflated
+    {
+        QByteArray data;
+        uint32_t crc = 0;
+        qint64 size = 0;
+    };
+
+    struct Block
+    {
+        QByteArray data;
+        QFuture<Deflated> deflated;
+    };
+
+    static Deflated deflateBlock(const QByteArray& data, const QByteArray& dictionary);
+
+    BoundedQueue<Block> m_Queue;
+    QFile m_File;
+    QFuture<bool> m_Writer;
+    QByteArray m_Dictionary; // End of the last block queued
+    bool m_Compress = false;
+    bool m_Open = false;
+    // Last, so it is gone before the queue and file the writer thread uses
+    QThreadPool m_WriterPool;
+};
+
+#endif
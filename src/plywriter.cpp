@@ -0,0 +1,87 @@
+#include "plywriter.h"
+
+#include <cstring>
+
+#include <QFile>
+#include <QtEndian>
+
+#include "chunkwriter.h"
+
+
+namespace {
+
+constexpr int vertexSize = 3 * sizeof(float);
+constexpr int faceSize = sizeof(uint8_t) + 3 * sizeof(uint32_t);
+
+char* putFloat(char* out, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian(bits, out);
+    return out + sizeof(bits);
+}
+
+char* putVertex(char* out, const QVector3D& v)
+{
+    out = putFloat(out, v.x());
+    out = putFloat(out, v.y());
+    return putFloat(out, v.z());
+}
+
+char* putFace(char* out, const uint32_t* indices)
+{
+    *out++ = 3;
+    for (int i = 0; i < 3; ++i)
+    {
+        qToLittleEndian(indices[i], out);
+        out += sizeof(uint32_t);
+    }
+    return out;
+}
+
+}
+
+bool writePly(const QString& path, const Mesh& mesh, const std::function<void(int)>& progress)
+{
+    const int noOfVertices = mesh.vertexCount();
+    const int noOfTriangles = mesh.triangleCount();
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    const QByteArray header = QString(
+        "ply\n"
+        "format binary_little_endian 1.0\n"
+        "comment LithoMaker\n"
+        "element vertex %1\n"
+        "property float x\n"
+        "property float y\n"
+        "property float z\n"
+        "element face %2\n"
+        "property list uchar uint vertex_indices\n"
+        "end_header\n"
+    ).arg(noOfVertices).arg(noOfTriangles).toUtf8();
+    bool ok = file.write(header) == header.size();
+
+    const auto output = [&file](const char* data, qint64 size) { return file.write(data, size) == size; };
+    const auto reportProgress = [&progress, noOfVertices, noOfTriangles](int done) {
+        if (progress) progress((int)((float)done / (float)(noOfVertices + noOfTriangles) * 100.0f));
+    };
+
+    // Vertices and faces have fixed sizes, so larger chunks keep the writes large
+    ChunkWriter vertexWriter(vertexSize, 1 << 16);
+    ok = ok && vertexWriter.write(
+        noOfVertices,
+        [&mesh](char* out, int i) { return putVertex(out, mesh.vertices.at(i)); },
+        output, reportProgress
+    );
+    ChunkWriter faceWriter(faceSize, 1 << 16);
+    ok = ok && faceWriter.write(
+        noOfTriangles,
+        [&mesh](char* out, int t) { return putFace(out, mesh.indices.constData() + t * 3); },
+        output, [&reportProgress, noOfVertices](int done) { reportProgress(noOfVertices + done); }
+    );
+
+    file.close();
+    return ok && file.error() == QFileDevice::NoError;
+}
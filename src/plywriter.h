@@ -0,0 +1,16 @@
+#ifndef __PLYWRITER_H__
+#define __PLYWRITER_H__
+
+#include <functional>
+
+#include <QString>
+
+#include "mesh.h"
+
+
+// Writes a mesh as binary little endian PLY: the shared vertices as float x,
+// y and z followed by the triangles as lists of three vertex indices.
+// 'progress' gets 0 - 100% from the calling thread.
+bool writePly(const QString& path, const Mesh& mesh, const std::function<void(int)>& progress = nullptr);
+
+#endif
@@ -8,6 +8,7 @@
 #include <QtCore>
 #include <Qt3DCore/QNode>
 #include <Qt3DRender/QRenderSettings>
+#include <Qt3DRender/QRenderCapture>
 #include <Qt3DCore/QComponent>
 #include <Qt3DCore/QTransform>
 #include <Qt3DRender/QMaterial>
@@ -24,10 +25,31 @@
 #include <Qt3DRender/QGeometry> 
 #include <Qt3DRender/QAttribute>
 #include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QEffect>
+#include <Qt3DRender/QFilterKey>
+#include <Qt3DRender/QGraphicsApiFilter>
+#include <Qt3DRender/QParameter>
+#include <Qt3DRender/QRenderPass>
+#include <Qt3DRender/QShaderProgram>
+#include <Qt3DRender/QTechnique>
+#include <Qt3DRender/QTexture>
+#include <Qt3DRender/QAbstractTextureImage>
+#include <Qt3DRender/QTextureImageData>
+#include <Qt3DRender/qtextureimagedatagenerator.h>
+#include <Qt3DRender/QTextureWrapMode>
 
 #include <QCoreApplication>
 #include <QEventLoop>
+#include <QFutureWatcher>
 #include <QTime>
+#include <QtConcurrent>
+#include <QVector2D>
+
+#include <algorithm>
+#include <cmath>
+
+#include "stlreader.h"
+#include "vertexcache.h"
 
 const QColor FrontColor = QColor(QRgb(0xa7d6ff));
 const QColor BackColor = QColor(QRgb(0xffc7a7));
@@ -35,6 +57,216 @@ const QColor LightColor = QColor(QRgb(0xffffff));
 const QColor XColor = QColor(QRgb(0xff0000));
 const QColor YColor = QColor(QRgb(0x00ff00));
 const QColor ZColor = QColor(QRgb(0x0000ff));
+const QVector3D LightPosition = QVector3D(0, 20.0f, 90.0f);
+const float LightIntensity = 0.5f;
+// Default of QDiffuseSpecularMaterial, for the heightmap shader to match
+const QColor DiffuseColor = QColor::fromRgbF(0.7f, 0.7f, 0.7f);
+// Safe on any OpenGL 3.2 implementation, larger images are scaled down
+const int MaxTextureSize = 8192;
+
+// Hands a QImage to Qt3D as texture data
+class HeightmapImageGenerator : public Qt3DRender::QTextureImageDataGenerator
+{
+public:
+    explicit HeightmapImageGenerator(const QImage& image) : image(image) {}
+
+    Qt3DRender::QTextureImageDataPtr operator()() override
+    {
+        Qt3DRender::QTextureImageDataPtr data = Qt3DRender::QTextureImageDataPtr::create();
+        data->setImage(image);
+        return data;
+    }
+
+    bool operator==(const Qt3DRender::QTextureImageDataGenerator& other) const override
+    {
+        const HeightmapImageGenerator *generator = Qt3DRender::functor_cast<HeightmapImageGenerator>(&other);
+        return generator != nullptr && generator->image.cacheKey() == image.cacheKey();
+    }
+
+    QT3D_FUNCTOR(HeightmapImageGenerator)
+
+private:
+    QImage image;
+};
+
+class HeightmapTextureImage : public Qt3DRender::QAbstractTextureImage
+{
+public:
+    HeightmapTextureImage(const QImage& image, Qt3DCore::QNode *parent = nullptr)
+        : Qt3DRender::QAbstractTextureImage(parent), image(image) {}
+
+protected:
+    Qt3DRender::QTextureImageDataGeneratorPtr dataGenerator() const override
+    {
+        return Qt3DRender::QTextureImageDataGeneratorPtr(new HeightmapImageGenerator(image));
+    }
+
+private:
+    QImage image;
+};
+
+static qint64 triangleCount(const QByteArray& vertices, const QByteArray& indices)
+{
+    if(indices.isEmpty()) return vertices.size() / ((3 + 3) * sizeof(float) * 3);
+    return indices.size() / (3 * sizeof(uint32_t));
+}
+
+static void setParameter(Qt3DRender::QMaterial *material, const QString& name, const QVariant& value)
+{
+    for(Qt3DRender::QParameter *parameter : material->parameters())
+    {
+        if(parameter->name() == name)
+        {
+            parameter->setValue(value);
+            return;
+        }
+    }
+    material->addParameter(new Qt3DRender::QParameter(name, value));
+}
+
+// Indexed triangles, or three vertices per triangle without indices, with
+// interleaved position and normal floats
+static Qt3DRender::QGeometryRenderer *createRenderer(Qt3DCore::QEntity *entity, const QByteArray& vertices, const QByteArray& indices)
+{
+    const uint32_t stride = (3 + 3) * sizeof(float);
+    const uint32_t noOfVertices = vertices.size() / stride;
+
+    Qt3DRender::QBuffer *vertexBuffer = new Qt3DRender::QBuffer(entity);
+    vertexBuffer->setData(vertices);
+
+    Qt3DRender::QAttribute *positionAttribute = new Qt3DRender::QAttribute(entity);
+    positionAttribute->setAttributeType(Qt3DRender::QAttribute::VertexAttribute);
+    positionAttribute->setBuffer(vertexBuffer);
+    positionAttribute->setVertexBaseType(Qt3DRender::QAttribute::Float);
+    positionAttribute->setVertexSize(3);
+    positionAttribute->setByteOffset(0);
+    positionAttribute->setByteStride(stride);
+    positionAttribute->setCount(noOfVertices);
+    positionAttribute->setName(Qt3DRender::QAttribute::defaultPositionAttributeName());
+
+    Qt3DRender::QAttribute *normalAttribute = new Qt3DRender::QAttribute(entity);
+    normalAttribute->setAttributeType(Qt3DRender::QAttribute::VertexAttribute);
+    normalAttribute->setBuffer(vertexBuffer);
+    normalAttribute->setVertexBaseType(Qt3DRender::QAttribute::Float);
+    normalAttribute->setVertexSize(3);
+    normalAttribute->setByteOffset(3 * sizeof(float));
+    normalAttribute->setByteStride(stride);
+    normalAttribute->setCount(noOfVertices);
+    normalAttribute->setName(Qt3DRender::QAttribute::defaultNormalAttributeName());
+
+    Qt3DRender::QGeometry *geometry = new Qt3DRender::QGeometry(entity);
+    geometry->addAttribute(positionAttribute);
+    geometry->addAttribute(normalAttribute);
+
+    Qt3DRender::QGeometryRenderer *renderer = new Qt3DRender::QGeometryRenderer(entity);
+    renderer->setPrimitiveType(Qt3DRender::QGeometryRenderer::Triangles);
+    renderer->setGeometry(geometry);
+    renderer->setVertexCount(noOfVertices);
+
+    if(!indices.isEmpty())
+    {
+        Qt3DRender::QBuffer *indexBuffer = new Qt3DRender::QBuffer(entity);
+        indexBuffer->setData(indices);
+
+        const uint32_t noOfIndices = indices.size() / sizeof(uint32_t);
+        Qt3DRender::QAttribute *indexAttribute = new Qt3DRender::QAttribute(entity);
+        indexAttribute->setAttributeType(Qt3DRender::QAttribute::IndexAttribute);
+        indexAttribute->setBuffer(indexBuffer);
+        indexAttribute->setVertexBaseType(Qt3DRender::QAttribute::UnsignedInt);
+        indexAttribute->setCount(noOfIndices);
+        geometry->addAttribute(indexAttribute);
+        renderer->setVertexCount(noOfIndices);
+    }
+    return renderer;
+}
+
+// Grid over the image for the heightmap shader, with side walls and a
+// backside, in the layout of createRenderer(). Positions are image pixels
+// from the bottom left with the kind of vertex in z: 0 on the surface, 1 on
+// top of a wall and 2 at the backside. The surface normal is left to the
+// shader, walls and backside have their own vertices and normals.
+static IndexedVertexData heightmapGrid(int imageWidth, int imageHeight, int maxTriangles)
+{
+    // Every step-th pixel like Lithophane::renderImage(), two triangles per cell
+    const double cells = (double)(imageWidth - 1) * (imageHeight - 1);
+    const int step = std::max(1, (int)std::ceil(std::sqrt(cells / std::max(1, maxTriangles / 2))));
+    const int w = (imageWidth - 2) / step + 2;
+    const int h = (imageHeight - 2) / step + 2;
+    auto sampleX = [step, imageWidth](int x) { return (float)std::min(x * step, imageWidth - 1); };
+    auto sampleY = [step, imageHeight](int y) { return (float)std::min(y * step, imageHeight - 1); };
+
+    const int noOfWallVertices = 2 * (2 * (w - 1) + 2 * (h - 1) + 4);
+    const int noOfQuads = (w - 1) * (h - 1) + 2 * (w - 1) + 2 * (h - 1) + 1;
+    IndexedVertexData data;
+    data.vertices.resize((w * h + noOfWallVertices + 4) * 6 * sizeof(float));
+    data.indices.resize(noOfQuads * 6 * sizeof(uint32_t));
+    float *vertex = reinterpret_cast<float *>(data.vertices.data());
+    uint32_t *index = reinterpret_cast<uint32_t *>(data.indices.data());
+    uint32_t noOfVertices = 0;
+
+    auto addVertex = [&](float x, float y, float kind, const QVector3D& normal) {
+        *vertex++ = x;
+        *vertex++ = y;
+        *vertex++ = kind;
+        *vertex++ = normal.x();
+        *vertex++ = normal.y();
+        *vertex++ = normal.z();
+        return noOfVertices++;
+    };
+
+    for(int y = 0; y < h; ++y)
+    {
+        for(int x = 0; x < w; ++x)
+        {
+            addVertex(sampleX(x), sampleY(y), 0.0f, QVector3D(0, 0, 1));
+        }
+    }
+    for(int y = 0; y < h - 1; ++y)
+    {
+        for(int x = 0; x < w - 1; ++x)
+        {
+            index = Mesh::putQuad(index, y * w + x, y * w + x + 1, (y + 1) * w + x + 1, (y + 1) * w + x);
+        }
+    }
+
+    // Counterclockwise around the border, seen from the front
+    struct Side
+    {
+        int x, y, dx, dy, length;
+        QVector3D normal;
+    };
+    const Side sides[] = {
+        {0, 0, 1, 0, w - 1, QVector3D(0, -1, 0)},
+        {w - 1, 0, 0, 1, h - 1, QVector3D(1, 0, 0)},
+        {w - 1, h - 1, -1, 0, w - 1, QVector3D(0, 1, 0)},
+        {0, h - 1, 0, -1, h - 1, QVector3D(-1, 0, 0)}
+    };
+    for(const Side& side : sides)
+    {
+        const uint32_t first = noOfVertices;
+        for(int i = 0; i <= side.length; ++i)
+        {
+            const float x = sampleX(side.x + i * side.dx), y = sampleY(side.y + i * side.dy);
+            addVertex(x, y, 1.0f, side.normal);
+            addVertex(x, y, 2.0f, side.normal);
+        }
+        for(int i = 0; i < side.length; ++i)
+        {
+            const uint32_t top = first + 2 * i, bottom = top + 1;
+            index = Mesh::putQuad(index, bottom, bottom + 2, top + 2, top);
+        }
+    }
+
+    const QVector3D back(0, 0, -1);
+    const uint32_t first = addVertex(0.0f, 0.0f, 2.0f, back);
+    addVertex(0.0f, imageHeight - 1, 2.0f, back);
+    addVertex(imageWidth - 1, imageHeight - 1, 2.0f, back);
+    addVertex(imageWidth - 1, 0.0f, 2.0f, back);
+    Mesh::putQuad(index, first, first + 1, first + 2, first + 3);
+
+    optimizeVertexCache(reinterpret_cast<uint32_t *>(data.indices.data()), noOfQuads * 2, noOfVertices);
+    return data;
+}
 
 Preview::Preview(QWidget *parent)
    : QWidget(parent)
@@ -45,8 +277,20 @@ Preview::Preview(QWidget *parent)
     container = createWindowContainer(view,this);
     view->defaultFrameGraph()->setClearColor(BackColor);
 
-    Qt3DRender::QRenderSettings *renderSettings = view->renderSettings();        
-    renderSettings->setRenderPolicy(Qt3DRender::QRenderSettings::Always);
+    // Only redraws when the camera, the scene or the window size changes,
+    // instead of burning a core while idle
+    Qt3DRender::QRenderSettings *renderSettings = view->renderSettings();
+    renderSettings->setRenderPolicy(Qt3DRender::QRenderSettings::OnDemand);
+
+    // Captures a frame only when asked to by timeFrame()
+    renderCapture = new Qt3DRender::QRenderCapture;
+    view->activeFrameGraph()->setParent(renderCapture);
+    view->setActiveFrameGraph(renderCapture);
+
+    // Widgets can't be drawn over the native 3D window, so the stats get a
+    // line of their own above it
+    statsLabel = new QLabel(this);
+    statsLabel->hide();
 
     // Camera
     camera = view->camera();
@@ -54,6 +298,8 @@ Preview::Preview(QWidget *parent)
     camera->setPosition(QVector3D(0, 20.0f, 90.0f));
     camera->setUpVector(QVector3D(0, 1, 0));
     camera->setViewCenter(QVector3D(0, 20.0f, 0));
+    connect(camera, &Qt3DRender::QCamera::viewMatrixChanged, this, &Preview::timeFrame);
+    connect(camera, &Qt3DRender::QCamera::projectionMatrixChanged, this, &Preview::timeFrame);
 
     // Root entity
     rootEntity = new Qt3DCore::QEntity();
@@ -62,10 +308,10 @@ Preview::Preview(QWidget *parent)
     Qt3DCore::QEntity *lightEntity = new Qt3DCore::QEntity(rootEntity);
     Qt3DRender::QPointLight *light = new Qt3DRender::QPointLight(lightEntity);
     light->setColor(LightColor);
-    light->setIntensity(0.5f);
+    light->setIntensity(LightIntensity);
     lightEntity->addComponent(light);
     Qt3DCore::QTransform *lightTransform = new Qt3DCore::QTransform(lightEntity);
-    lightTransform->setTranslation(camera->position());
+    lightTransform->setTranslation(LightPosition);
     lightEntity->addComponent(lightTransform);
 
     auto *camController = new Qt3DExtras::QOrbitCameraController(rootEntity);
@@ -124,9 +370,26 @@ void Preview::createAxe(const QVector3D& p1, const QVector3D& p2, const QColor&
 
 void Preview::loadStl(const QString& path)
 {
-    if(lithophaneEntity != nullptr) lithophaneEntity->deleteLater();
-    // Lithophane Entity
-    lithophaneEntity = new Qt3DCore::QEntity(rootEntity);
+    if(!path.endsWith(".stl", Qt::CaseInsensitive) && !path.endsWith(".stl.gz", Qt::CaseInsensitive))
+    {
+        loadScene(path);
+        return;
+    }
+
+    const int generation = ++loadGeneration;
+    auto *watcher = new QFutureWatcher<QByteArray>(this);
+    connect(watcher, &QFutureWatcher<QByteArray>::finished, this, [this, watcher, generation]() {
+        const QByteArray data = watcher->result();
+        if(generation == loadGeneration && !data.isEmpty()) showVertexBuffer(data, QByteArray());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(readStlVertexBuffer, path));
+}
+
+void Preview::loadScene(const QString& path)
+{
+    ++loadGeneration;
+    newLithophaneEntity();
  
     // Lithophane Mesh
     auto* sceneLoader = new Qt3DRender::QSceneLoader(lithophaneEntity);
@@ -152,87 +415,174 @@ void Preview::loadStl(const QString& path)
     });
 
     sceneLoader->setSource(QUrl::fromLocalFile(path));  // fileUrl is input
+    noOfTriangles = -1;
+    updateStats();
 }
 
-void Preview::loadData(const QList<QVector3D>& vertices)
+void Preview::loadVertexBuffer(const IndexedVertexData& data)
 {
-    const uint32_t noOfVertices = vertices.count();
-    QByteArray vertexBufferData;
-    vertexBufferData.resize(vertices.size() * sizeof(QVector3D) * 2);
-    float *rawVertexArray = reinterpret_cast<float *>(vertexBufferData.data());
-
-    uint32_t i = 0;
-    for(uint32_t idx = 0; idx < noOfVertices; idx += 3)
-    {
-        const QVector3D &v1 = vertices.at(idx);
-        const QVector3D &v2 = vertices.at(idx + 1);
-        const QVector3D &v3 = vertices.at(idx + 2);
-        const QVector3D &normal = QVector3D::normal(v1, v2, v3);
-
-        rawVertexArray[i++] = v1.x();
-        rawVertexArray[i++] = v1.y();
-        rawVertexArray[i++] = v1.z();
-        rawVertexArray[i++] = normal.x();
-        rawVertexArray[i++] = normal.y();
-        rawVertexArray[i++] = normal.z();
-
-        rawVertexArray[i++] = v2.x();
-        rawVertexArray[i++] = v2.y();
-        rawVertexArray[i++] = v2.z();
-        rawVertexArray[i++] = normal.x();
-        rawVertexArray[i++] = normal.y();
-        rawVertexArray[i++] = normal.z();
-
-        rawVertexArray[i++] = v3.x();
-        rawVertexArray[i++] = v3.y();
-        rawVertexArray[i++] = v3.z();
-        rawVertexArray[i++] = normal.x();
-        rawVertexArray[i++] = normal.y();
-        rawVertexArray[i++] = normal.z();
-    }
+    ++loadGeneration;
+    showVertexBuffer(data.vertices, data.indices);
+}
 
-    // Lithophane Entity
+void Preview::newLithophaneEntity()
+{
     if(lithophaneEntity != nullptr) lithophaneEntity->deleteLater();
     lithophaneEntity = new Qt3DCore::QEntity(rootEntity);
+    heightmapMaterial = nullptr;
+    detailsEntity = nullptr;
+    noOfTriangles = 0;
+    bufferSize = 0;
+    noOfDetailsTriangles = 0;
+    detailsBufferSize = 0;
+    updateStats();
+    timeFrame();
+}
 
-    Qt3DRender::QBuffer *vertexBuffer = new Qt3DRender::QBuffer(lithophaneEntity);
-    vertexBuffer->setData(vertexBufferData);
-
-    const uint32_t stride = (3 + 3) * sizeof(float);
-    Qt3DRender::QAttribute *positionAttribute = new Qt3DRender::QAttribute(lithophaneEntity);
-    positionAttribute->setAttributeType(Qt3DRender::QAttribute::VertexAttribute);
-    positionAttribute->setBuffer(vertexBuffer);
-    positionAttribute->setVertexBaseType(Qt3DRender::QAttribute::Float);
-    positionAttribute->setVertexSize(3);
-    positionAttribute->setByteOffset(0);
-    positionAttribute->setByteStride(stride);
-    positionAttribute->setName(Qt3DRender::QAttribute::defaultPositionAttributeName());
-
-    Qt3DRender::QAttribute *normalAttribute = new Qt3DRender::QAttribute(lithophaneEntity);
-    normalAttribute->setAttributeType(Qt3DRender::QAttribute::VertexAttribute);
-    normalAttribute->setBuffer(vertexBuffer);
-    normalAttribute->setVertexBaseType(Qt3DRender::QAttribute::Float);
-    normalAttribute->setVertexSize(3);
-    normalAttribute->setByteOffset(3 * sizeof(float));
-    normalAttribute->setByteStride(stride);
-    normalAttribute->setName(Qt3DRender::QAttribute::defaultNormalAttributeName());
-
-    Qt3DRender::QGeometry *geometry = new Qt3DRender::QGeometry(lithophaneEntity);
-    geometry->addAttribute(positionAttribute);
-    geometry->addAttribute(normalAttribute);
-
-    Qt3DRender::QGeometryRenderer *renderer = new Qt3DRender::QGeometryRenderer(lithophaneEntity);
-    renderer->setPrimitiveType(Qt3DRender::QGeometryRenderer::Triangles);
-    renderer->setGeometry(geometry);
-    renderer->setVertexCount(noOfVertices);
-    renderer->setPrimitiveRestartEnabled(true);
-    renderer->setRestartIndexValue(0);
+void Preview::showVertexBuffer(const QByteArray& vertices, const QByteArray& indices)
+{
+    newLithophaneEntity();
 
     Qt3DExtras::QDiffuseSpecularMaterial *lithophaneMaterial = new Qt3DExtras::QDiffuseSpecularMaterial;
     lithophaneMaterial->setAmbient(FrontColor);
 
     // make entity
-    lithophaneEntity->addComponent(renderer);
+    lithophaneEntity->addComponent(createRenderer(lithophaneEntity, vertices, indices));
     lithophaneEntity->addComponent(lithophaneMaterial);
-    
-}
\ No newline at end of file
+    noOfTriangles = triangleCount(vertices, indices);
+    bufferSize = vertices.size() + indices.size();
+    updateStats();
+}
+
+void Preview::loadHeightmap(const QImage& image, int maxTriangles)
+{
+    ++loadGeneration;
+    newLithophaneEntity();
+    heightmapSize = image.size();
+
+    Qt3DRender::QTexture2D *texture = new Qt3DRender::QTexture2D(lithophaneEntity);
+    texture->setMinificationFilter(Qt3DRender::QAbstractTexture::Linear);
+    texture->setMagnificationFilter(Qt3DRender::QAbstractTexture::Linear);
+    texture->setWrapMode(Qt3DRender::QTextureWrapMode(Qt3DRender::QTextureWrapMode::ClampToEdge));
+    // Positions stay in pixels of the full image, only the texture gets coarser
+    const QImage textureImage = std::max(image.width(), image.height()) > MaxTextureSize ?
+        image.scaled(MaxTextureSize, MaxTextureSize, Qt::KeepAspectRatio, Qt::SmoothTransformation) : image;
+    texture->addTextureImage(new HeightmapTextureImage(textureImage));
+
+    Qt3DRender::QShaderProgram *shader = new Qt3DRender::QShaderProgram;
+    shader->setVertexShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl("qrc:/heightmap.vert")));
+    shader->setFragmentShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl("qrc:/heightmap.frag")));
+    Qt3DRender::QRenderPass *renderPass = new Qt3DRender::QRenderPass;
+    renderPass->setShaderProgram(shader);
+
+    // Picked by the forward renderer of Qt3DWindow
+    Qt3DRender::QFilterKey *filterKey = new Qt3DRender::QFilterKey;
+    filterKey->setName("renderingStyle");
+    filterKey->setValue("forward");
+
+    Qt3DRender::QTechnique *technique = new Qt3DRender::QTechnique;
+    technique->graphicsApiFilter()->setApi(Qt3DRender::QGraphicsApiFilter::OpenGL);
+    technique->graphicsApiFilter()->setProfile(Qt3DRender::QGraphicsApiFilter::CoreProfile);
+    technique->graphicsApiFilter()->setMajorVersion(3);
+    technique->graphicsApiFilter()->setMinorVersion(2);
+    technique->addFilterKey(filterKey);
+    technique->addRenderPass(renderPass);
+
+    Qt3DRender::QEffect *effect = new Qt3DRender::QEffect;
+    effect->addTechnique(technique);
+
+    heightmapMaterial = new Qt3DRender::QMaterial(lithophaneEntity);
+    heightmapMaterial->setEffect(effect);
+    heightmapMaterial->addParameter(new Qt3DRender::QParameter("heightmap", texture));
+    setParameter(heightmapMaterial, "imageSize", QVector2D(image.width(), image.height()));
+    setParameter(heightmapMaterial, "ambient", FrontColor);
+    setParameter(heightmapMaterial, "diffuse", DiffuseColor);
+    setParameter(heightmapMaterial, "lightPosition", LightPosition);
+    setParameter(heightmapMaterial, "lightIntensity", LightIntensity);
+
+    const IndexedVertexData grid = heightmapGrid(image.width(), image.height(), maxTriangles);
+    lithophaneEntity->addComponent(createRenderer(lithophaneEntity, grid.vertices, grid.indices));
+    lithophaneEntity->addComponent(heightmapMaterial);
+    noOfTriangles = triangleCount(grid.vertices, grid.indices);
+    bufferSize = grid.vertices.size() + grid.indices.size() + (qint64)textureImage.bytesPerLine() * textureImage.height();
+    updateStats();
+}
+
+void Preview::updateHeightmap(float width, float totalThickness, float minThickness, float frameBorder,
+                              const IndexedVertexData& details)
+{
+    if(heightmapMaterial == nullptr) return;
+
+    setParameter(heightmapMaterial, "pixelSize", (width - frameBorder * 2.0f) / heightmapSize.width());
+    setParameter(heightmapMaterial, "frameBorder", frameBorder);
+    setParameter(heightmapMaterial, "width", width);
+    setParameter(heightmapMaterial, "depth", totalThickness - minThickness);
+    setParameter(heightmapMaterial, "minThickness", minThickness);
+
+    // The frame and such are small enough to upload again every time
+    if(detailsEntity != nullptr) detailsEntity->deleteLater();
+    detailsEntity = new Qt3DCore::QEntity(lithophaneEntity);
+    noOfDetailsTriangles = triangleCount(details.vertices, details.indices);
+    detailsBufferSize = details.vertices.size() + details.indices.size();
+    updateStats();
+    timeFrame();
+    if(details.indices.isEmpty()) return;
+
+    Qt3DExtras::QDiffuseSpecularMaterial *detailsMaterial = new Qt3DExtras::QDiffuseSpecularMaterial;
+    detailsMaterial->setAmbient(FrontColor);
+    detailsEntity->addComponent(createRenderer(detailsEntity, details.vertices, details.indices));
+    detailsEntity->addComponent(detailsMaterial);
+}
+
+void Preview::setStatsVisible(bool visible)
+{
+    showStats = visible;
+    statsLabel->setVisible(visible);
+    resizeView(size());
+    updateStats();
+    timeFrame();
+}
+
+void Preview::resizeView(QSize size)
+{
+    const int top = showStats? statsLabel->sizeHint().height() : 0;
+    statsLabel->setGeometry(0, 0, size.width(), top);
+    container->setGeometry(0, top, size.width(), size.height() - top);
+    timeFrame();
+}
+
+void Preview::timeFrame()
+{
+    if(!showStats) return;
+    // A change during the timed frame may not have made it into that frame,
+    // so another one is timed after it
+    if(framePending)
+    {
+        frameRequested = true;
+        return;
+    }
+
+    framePending = true;
+    frameRequested = false;
+    frameTimer.start();
+    Qt3DRender::QRenderCaptureReply *reply = renderCapture->requestCapture();
+    connect(reply, &Qt3DRender::QRenderCaptureReply::completed, this, [this, reply]() {
+        frameTime = frameTimer.nsecsElapsed() / 1000000.0;
+        framePending = false;
+        reply->deleteLater();
+        updateStats();
+        if(frameRequested) timeFrame();
+    });
+}
+
+void Preview::updateStats()
+{
+    if(!showStats) return;
+
+    const QString frame = frameTime < 0? QString("-") : QLocale().toString(frameTime, 'f', 1);
+    // Buffers of scenes Qt3D loads itself aren't known
+    const bool known = noOfTriangles >= 0;
+    const QString count = known? QLocale().toString(noOfTriangles + noOfDetailsTriangles) : QString("-");
+    const QString megabytes = known? QLocale().toString((bufferSize + detailsBufferSize) / 1048576.0, 'f', 1) : QString("-");
+    statsLabel->setText(tr("Frame: %1 ms, triangles: %2, GPU buffers: %3 MB").arg(frame, count, megabytes));
+}
@@ -1,10 +1,18 @@
 #ifndef __PREVIEW_H__
 #define __PREVIEW_H__
 
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QLabel>
 #include <QObject>
 #include <QWidget>
 #include <Qt3DCore/QEntity>
 #include <Qt3DRender/QCamera>
+#include <Qt3DRender/QMaterial>
+#include <Qt3DRender/QRenderCapture>
+
+#include "mesh.h"
 
 
 class Preview : public QWidget
@@ -16,15 +24,62 @@ private:
     // Root and lithophane entities
     Qt3DCore::QEntity *rootEntity = nullptr, *lithophaneEntity = nullptr;
     Qt3DRender::QCamera *camera = nullptr;
+    // Set while the image surface is drawn by the heightmap shader
+    Qt3DRender::QMaterial *heightmapMaterial = nullptr;
+    Qt3DCore::QEntity *detailsEntity = nullptr;
+    QSize heightmapSize;
+
+    // Cost of the preview, shown above the view when enabled
+    QLabel *statsLabel;
+    bool showStats = false;
+    // Triangles and bytes of the lithophane's buffers and texture, with
+    // -1 triangles for scenes Qt3D loads itself
+    qint64 noOfTriangles = 0, bufferSize = 0;
+    qint64 noOfDetailsTriangles = 0, detailsBufferSize = 0;
+    // Frames are timed by capturing them, one at a time
+    Qt3DRender::QRenderCapture *renderCapture;
+    QElapsedTimer frameTimer;
+    bool framePending = false, frameRequested = false;
+    // Milliseconds from a change to its frame being read back
+    double frameTime = -1;
+
+    // Bumped by every load, so an earlier loadStl() finishing late can't
+    // replace what was loaded after it
+    int loadGeneration = 0;
 
     // Private methods
     void createAxe(const QVector3D& p1, const QVector3D& p2, const QColor& color);
+    // Other formats go through Qt3D's scene loader
+    void loadScene(const QString& path);
+    // Draws indexed triangles, or three vertices per triangle without indices
+    void showVertexBuffer(const QByteArray& vertices, const QByteArray& indices);
+    // Replaces whatever is shown with an empty lithophane entity
+    void newLithophaneEntity();
+    // Times the frame showing a change to the view, if the stats are shown
+    void timeFrame();
+    void updateStats();
 
 public:
     Preview(QWidget *parent = nullptr);
 
+    // STL files, also gzip compressed, are read on a worker thread and shown
+    // when done
     void loadStl(const QString& path);
-    void loadData(const QList<QVector3D>& vertices);
+    // Shows triangles packed by Mesh::indexedVertexData(). The buffers are
+    // shared with Qt3D rather than copied.
+    void loadVertexBuffer(const IndexedVertexData& data);
+    // Draws the image surface on the graphics card instead, displacing a
+    // grid of about 'maxTriangles' triangles by the grayscale 'image' in the
+    // vertex shader. The image is uploaded once, after which the shape
+    // follows updateHeightmap() without building a mesh again.
+    void loadHeightmap(const QImage& image, int maxTriangles);
+    // Sizes in mm as for Lithophane::configure(). 'details' are the frame,
+    // hangers and stabilizers, packed by Mesh::indexedVertexData().
+    void updateHeightmap(float width, float totalThickness, float minThickness, float frameBorder,
+                         const IndexedVertexData& details);
+    bool isShowingHeightmap() const { return heightmapMaterial != nullptr; }
+    // Frame time, triangle count and GPU buffer size above the view
+    void setStatsVisible(bool visible);
     void setCameraPosition(const QVector3D& position)
     {
         if(camera) {
@@ -40,10 +95,7 @@ protected:
     }
 
 public slots:
-    void resizeView(QSize size)
-    {
-        container->resize(size);
-    }
+    void resizeView(QSize size);
 
 };
 
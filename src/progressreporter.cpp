@@ -0,0 +1,86 @@
+#include "progressreporter.h"
+
+#include <algorithm>
+
+#include <QMutexLocker>
+
+
+namespace {
+
+QString formatRate(double rate)
+{
+    if (rate >= 1e6) return QString::number(rate / 1e6, 'f', 1) + " M";
+    if (rate >= 1e3) return QString::number(rate / 1e3, 'f', 1) + " k";
+    return QString::number(rate, 'f', 0);
+}
+
+}
+
+ProgressReporter::ProgressReporter()
+{
+    m_Clock.start();
+}
+
+void ProgressReporter::start(const QString& stage, qint64 total, const QString& unit)
+{
+    {
+        QMutexLocker locker(&m_Mutex);
+        m_Stage = stage;
+        m_Unit = unit;
+    }
+    m_Total = total;
+    m_Done = 0;
+    m_StageStart = m_Clock.elapsed();
+    publish(0, true);
+}
+
+void ProgressReporter::add(qint64 items)
+{
+    publish(m_Done.fetch_add(items, std::memory_order_relaxed) + items, false);
+}
+
+void ProgressReporter::setDone(qint64 done)
+{
+    m_Done.store(done, std::memory_order_relaxed);
+    publish(done, false);
+}
+
+void ProgressReporter::finish()
+{
+    m_Done = m_Total.load();
+    publish(m_Total, true);
+}
+
+void ProgressReporter::publish(qint64 done, bool force)
+{
+    const qint64 now = m_Clock.elapsed();
+    qint64 last = m_LastPublish.load(std::memory_order_relaxed);
+    if (!force && now - last < interval) return;
+    // Of the threads getting here at the same time, only one reports
+    if (!m_LastPublish.compare_exchange_strong(last, now) && !force) return;
+
+    const qint64 total = m_Total;
+    const int percent = total > 0 ? (int)std::min<qint64>(done * 100 / total, 100) : 0;
+    if (m_LastPercent.exchange(percent) == percent && !force) return;
+
+    QString stage, unit;
+    {
+        QMutexLocker locker(&m_Mutex);
+        stage = m_Stage;
+        unit = m_Unit;
+    }
+
+    // Speed and time left settle after a moment
+    QString text = tr("%1...").arg(stage);
+    const double seconds = (now - m_StageStart) / 1000.0;
+    if (seconds >= 0.5 && done > 0 && done < total)
+    {
+        const double rate = done / seconds;
+        const QString left = QString::number((qint64)((total - done) / rate + 0.5));
+        if (unit.isEmpty()) text = tr("%1... %2 s left").arg(stage, left);
+        else text = tr("%1... %2 %3/s, %4 s left").arg(stage, formatRate(rate), unit, left);
+    }
+
+    emit progress(percent);
+    emit status(text);
+}
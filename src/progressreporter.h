@@ -0,0 +1,55 @@
+#ifndef __PROGRESSREPORTER_H__
+#define __PROGRESSREPORTER_H__
+
+#include <atomic>
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+
+
+// Collects progress from any number of worker threads and passes it on at a
+// bounded rate. Workers only bump an atomic counter; whichever thread notices
+// that the last update is more than a frame old emits the signals, and only
+// if the percentage changed. Signals emitted on worker threads reach the GUI
+// as queued connections.
+class ProgressReporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    ProgressReporter();
+
+    // Starts a stage of 'total' items counted in 'unit' ("rows", "triangles"),
+    // or without rates when 'unit' is empty. Reported right away.
+    void start(const QString& stage, qint64 total, const QString& unit = QString());
+
+    // Both are thread safe and cheap enough to call for every small batch of items
+    void add(qint64 items);
+    void setDone(qint64 done);
+
+    // Reports the stage as complete
+    void finish();
+
+signals:
+    void progress(int percent);
+    // Stage, speed and time left, like "Rendering... 1.2 M rows/s, 3 s left"
+    void status(const QString& text);
+
+private:
+    void publish(qint64 done, bool force);
+
+    static constexpr qint64 interval = 33; // Milliseconds, about 30 updates per second
+
+    QElapsedTimer m_Clock;
+    QMutex m_Mutex; // Guards the stage name and unit
+    QString m_Stage, m_Unit;
+    std::atomic<qint64> m_Done{0};
+    std::atomic<qint64> m_Total{0};
+    std::atomic<qint64> m_StageStart{0};
+    std::atomic<qint64> m_LastPublish{0};
+    std::atomic<int> m_LastPercent{-1};
+};
+
+#endif
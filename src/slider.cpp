@@ -83,6 +83,7 @@ void Slider::saveToConfig()
 
   settings->setValue(key, lineEdit->text());
   qDebug("Key '%s' saved to config with value '%s'\n", key.toStdString().c_str(), lineEdit->text().toStdString().c_str());
+  emit valueChanged();
 }
 
 void Slider::setSlider()
@@ -43,6 +43,10 @@ public:
 public slots:
   void resetToDefault();
 
+signals:
+  // After the new value was saved to the config
+  void valueChanged();
+
 protected:
   
 private slots:
@@ -0,0 +1,220 @@
+#include "stlreader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+#include <QFile>
+#include <QVector>
+#include <QVector3D>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include <zlib.h>
+
+
+namespace {
+
+constexpr int headerSize = 84;
+constexpr int facetSize = 50;
+constexpr int floatsPerFacet = 3 * (3 + 3);
+
+// Facets converted per task
+constexpr uint32_t facetsPerRange = 1 << 16;
+
+// QByteArray holds a little less than 2 GB
+constexpr qint64 maxArraySize = 2000000000;
+
+float getFloat(const char* in)
+{
+    const quint32 bits = qFromLittleEndian<quint32>(in);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+QVector3D getVector(const char* in)
+{
+    return QVector3D(getFloat(in), getFloat(in + 4), getFloat(in + 8));
+}
+
+float* putCorner(float* out, const QVector3D& p, const QVector3D& normal)
+{
+    out[0] = p.x();
+    out[1] = p.y();
+    out[2] = p.z();
+    out[3] = normal.x();
+    out[4] = normal.y();
+    out[5] = normal.z();
+    return out + 6;
+}
+
+float* putFacet(float* out, const QVector3D& p1, const QVector3D& p2, const QVector3D& p3)
+{
+    const QVector3D normal = QVector3D::normal(p1, p2, p3);
+    out = putCorner(out, p1, normal);
+    out = putCorner(out, p2, normal);
+    return putCorner(out, p3, normal);
+}
+
+// Binary files may start with "solid" as well, but only they have a size
+// matching the facet count in the header
+bool isBinary(const char* data, qint64 size)
+{
+    return size >= headerSize &&
+        headerSize + (qint64)qFromLittleEndian<quint32>(data + headerSize - sizeof(quint32)) * facetSize == size;
+}
+
+QByteArray readBinary(const char* data, qint64 size)
+{
+    const uint32_t noOfFacets = (size - headerSize) / facetSize;
+    if (noOfFacets == 0 || (qint64)noOfFacets * floatsPerFacet * sizeof(float) > maxArraySize) return QByteArray();
+
+    QByteArray buffer;
+    buffer.resize(noOfFacets * floatsPerFacet * sizeof(float));
+    float *vertices = reinterpret_cast<float *>(buffer.data());
+
+    QVector<uint32_t> ranges;
+    for (uint32_t first = 0; first < noOfFacets; first += facetsPerRange)
+    {
+        ranges.append(first);
+    }
+    QtConcurrent::blockingMap(ranges, [=](uint32_t first) {
+        const uint32_t last = std::min(noOfFacets - first, facetsPerRange) + first;
+        // Skips the normal stored in the file
+        const char *in = data + headerSize + (qint64)first * facetSize + 3 * sizeof(float);
+        float *out = vertices + (qint64)first * floatsPerFacet;
+        for (uint32_t f = first; f < last; ++f, in += facetSize)
+        {
+            out = putFacet(out, getVector(in), getVector(in + 12), getVector(in + 24));
+        }
+    });
+    return buffer;
+}
+
+const char* skipSpace(const char* p, const char* end)
+{
+    while (p < end && isspace((unsigned char)*p)) ++p;
+    return p;
+}
+
+QByteArray readAscii(const char* data, qint64 size)
+{
+    // Only the "vertex x y z" lines matter, every three of them make a facet
+    QVector<QVector3D> corners;
+    const char *end = data + size;
+    for (const char *p = skipSpace(data, end); p < end; p = skipSpace(p, end))
+    {
+        const char *word = p;
+        while (p < end && !isspace((unsigned char)*p)) ++p;
+        if (p - word != 6 || memcmp(word, "vertex", 6) != 0) continue;
+
+        float xyz[3];
+        for (float& value : xyz)
+        {
+            p = skipSpace(p, end);
+            if (p < end && *p == '+') ++p;
+            const std::from_chars_result result = std::from_chars(p, end, value);
+            if (result.ec != std::errc()) return QByteArray();
+            p = result.ptr;
+        }
+        corners.append(QVector3D(xyz[0], xyz[1], xyz[2]));
+    }
+
+    const qint64 noOfFacets = corners.count() / 3;
+    if (noOfFacets == 0 || corners.count() % 3 != 0 || noOfFacets * floatsPerFacet * sizeof(float) > maxArraySize)
+    {
+        return QByteArray();
+    }
+
+    QByteArray buffer;
+    buffer.resize(noOfFacets * floatsPerFacet * sizeof(float));
+    float *out = reinterpret_cast<float *>(buffer.data());
+    for (int i = 0; i < corners.count(); i += 3)
+    {
+        out = putFacet(out, corners.at(i), corners.at(i + 1), corners.at(i + 2));
+    }
+    return buffer;
+}
+
+// The whole decompressed file, including any further gzip members appended
+// to the first, or an empty array if it isn't valid gzip data
+QByteArray inflateGzip(const char* data, qint64 size)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) return QByteArray();
+
+    QByteArray out;
+    qint64 produced = 0;
+    const char *in = data, *end = data + size;
+    int result = Z_OK;
+    for (;;)
+    {
+        // zlib counts in 32 bits, so very large files are fed in pieces
+        if (stream.avail_in == 0 && in < end)
+        {
+            const qint64 piece = std::min<qint64>(end - in, 1 << 30);
+            stream.next_in = (Bytef*)in;
+            stream.avail_in = piece;
+            in += piece;
+        }
+        if (produced == out.size())
+        {
+            if (out.size() == maxArraySize) break;
+            out.resize(std::min(std::max<qint64>({out.size() * 2, size * 4, 1 << 16}), maxArraySize));
+        }
+
+        stream.next_out = (Bytef*)out.data() + produced;
+        stream.avail_out = out.size() - produced;
+        result = inflate(&stream, Z_NO_FLUSH);
+        produced = out.size() - stream.avail_out;
+
+        if (result == Z_STREAM_END)
+        {
+            if (stream.avail_in == 0 && in == end) break;
+            inflateReset(&stream);
+        }
+        else if (result != Z_OK && !(result == Z_BUF_ERROR && (stream.avail_in > 0 || in < end)))
+        {
+            break;
+        }
+    }
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END) return QByteArray();
+    out.resize(produced);
+    return out;
+}
+
+}
+
+QByteArray readStlVertexBuffer(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+    qint64 size = file.size();
+    if (size == 0) return QByteArray();
+
+    // A mapped file is paged in by the threads converting it instead of being
+    // copied into memory first
+    QByteArray contents;
+    const char *data = reinterpret_cast<const char *>(file.map(0, size));
+    if (data == nullptr)
+    {
+        contents = file.readAll();
+        data = contents.constData();
+        size = contents.size();
+    }
+    if (path.endsWith(".gz", Qt::CaseInsensitive))
+    {
+        contents = inflateGzip(data, size);
+        data = contents.constData();
+        size = contents.size();
+    }
+
+    if (isBinary(data, size)) return readBinary(data, size);
+    if (size >= 5 && memcmp(data, "solid", 5) == 0) return readAscii(data, size);
+    return QByteArray();
+}
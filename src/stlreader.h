@@ -0,0 +1,16 @@
+#ifndef __STLREADER_H__
+#define __STLREADER_H__
+
+#include <QByteArray>
+#include <QString>
+
+
+// Reads a binary or ascii STL file, gzip compressed when 'path' ends in
+// ".gz", into flat shaded triangles as interleaved position and normal
+// floats, three vertices per triangle without indices. Plain binary files are
+// memory mapped and converted by several threads. Normals are computed from
+// the corners, as many programs leave them zero. Returns an empty array if
+// the file can't be read or isn't an STL file.
+QByteArray readStlVertexBuffer(const QString& path);
+
+#endif
@@ -0,0 +1,251 @@
+#include "stlwriter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#if defined(Q_OS_LINUX)
+#include <fcntl.h>
+#endif
+
+#include <QFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include "chunkwriter.h"
+
+
+namespace {
+
+char* putFloat(char* out, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian(bits, out);
+    return out + sizeof(bits);
+}
+
+char* putVector(char* out, const QVector3D& v)
+{
+    out = putFloat(out, v.x());
+    out = putFloat(out, v.y());
+    return putFloat(out, v.z());
+}
+
+// Longest text putTextFacet() writes: 12 numbers of at most 13 characters
+// ("-1.23457e+10") plus the keywords, spaces and newlines
+constexpr int maxTextFacetSize = 12 * 13 + 128;
+
+char* putText(char* out, const char* text)
+{
+    const size_t length = strlen(text);
+    memcpy(out, text, length);
+    return out + length;
+}
+
+// Same as '<< v.x() << " " << v.y() << " " << v.z()' with the default stream precision
+char* putTextVector(char* out, const QVector3D& v)
+{
+    out = std::to_chars(out, out + 13, v.x(), std::chars_format::general, 6).ptr;
+    *out++ = ' ';
+    out = std::to_chars(out, out + 13, v.y(), std::chars_format::general, 6).ptr;
+    *out++ = ' ';
+    return std::to_chars(out, out + 13, v.z(), std::chars_format::general, 6).ptr;
+}
+
+char* putTextFacet(char* out, const QVector3D& normal, const QVector3D& p1, const QVector3D& p2, const QVector3D& p3)
+{
+    out = putText(out, "facet normal ");
+    out = putTextVector(out, normal);
+    out = putText(out, "\nouter loop\n");
+    for (const QVector3D* p : {&p1, &p2, &p3})
+    {
+        out = putText(out, "vertex ");
+        out = putTextVector(out, *p);
+        *out++ = '\n';
+    }
+    return putText(out, "endloop\nendfacet\n");
+}
+
+}
+
+StlStreamWriter::StlStreamWriter(int queueCapacity) :
+    m_Output(queueCapacity)
+{
+}
+
+StlStreamWriter::~StlStreamWriter()
+{
+    if (m_Open) close();
+}
+
+bool StlStreamWriter::open(const QString& path, bool compress, uint32_t noOfFacets)
+{
+    if (!m_Output.open(path, compress)) return false;
+    m_Path = path;
+    m_HeaderFacets = noOfFacets;
+    m_NoOfFacets = 0;
+    m_Open = true;
+
+    QByteArray header(headerSize, 0);
+    strcpy(header.data(), "lithophane");
+    qToLittleEndian(noOfFacets, header.data() + headerSize - sizeof(uint32_t));
+    m_Output.write(header);
+    return true;
+}
+
+void StlStreamWriter::write(QByteArray facets)
+{
+    m_NoOfFacets += facets.size() / facetSize;
+    m_Output.write(std::move(facets));
+}
+
+bool StlStreamWriter::close()
+{
+    if (!m_Open) return false;
+    m_Open = false;
+
+    bool ok = m_Output.close();
+    if (m_NoOfFacets == m_HeaderFacets) return ok;
+    if (m_Output.isCompressed()) return false;
+
+    // The count wasn't known when the header was written
+    QFile file(m_Path);
+    char count[sizeof(uint32_t)];
+    qToLittleEndian(m_NoOfFacets, count);
+    ok = ok && file.open(QIODevice::ReadWrite) &&
+        file.seek(headerSize - sizeof(uint32_t)) && file.write(count, sizeof(count)) == sizeof(count);
+    file.close();
+    return ok;
+}
+
+char* StlStreamWriter::putFacet(char* out, const QVector3D& p1, const QVector3D& p2, const QVector3D& p3)
+{
+    return putFacet(out, QVector3D::normal(p1, p2, p3), p1, p2, p3);
+}
+
+char* StlStreamWriter::putFacet(char* out, const QVector3D& normal, const QVector3D& p1, const QVector3D& p2, const QVector3D& p3)
+{
+    out = putVector(out, normal);
+    out = putVector(out, p1);
+    out = putVector(out, p2);
+    out = putVector(out, p3);
+    memset(out, 0, sizeof(uint16_t)); // Attribute byte count
+    return out + sizeof(uint16_t);
+}
+
+bool writeBinaryStl(const QString& path, const Mesh& mesh, const std::function<void(int)>& progress, bool compress)
+{
+    constexpr int headerSize = StlStreamWriter::headerSize;
+    constexpr int facetSize = StlStreamWriter::facetSize;
+    const uint32_t noOfTriangles = mesh.triangleCount();
+    const qint64 fileSize = headerSize + (qint64)noOfTriangles * facetSize;
+
+    const auto packFacet = [&mesh](char* out, int t) {
+        return StlStreamWriter::putFacet(out, mesh.normal(t), mesh.vertex(t, 0), mesh.vertex(t, 1), mesh.vertex(t, 2));
+    };
+    if (compress)
+    {
+        StlStreamWriter writer;
+        if (!writer.open(path, true, noOfTriangles)) return false;
+        ChunkWriter chunks(facetSize, 1 << 14);
+        chunks.write(
+            noOfTriangles, packFacet,
+            [&writer](const char* data, qint64 size) { writer.write(QByteArray(data, size)); return true; },
+            [&progress, noOfTriangles](int done) { if (progress) progress((int)((float)done / (float)noOfTriangles * 100.0f)); }
+        );
+        return writer.close();
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) return false;
+    bool ok = file.resize(fileSize);
+#if defined(Q_OS_LINUX)
+    // resize() leaves a sparse file, and running out of disk space while
+    // writing through a mapping is a crash rather than an error
+    ok = ok && posix_fallocate(file.handle(), 0, fileSize) != ENOSPC;
+#endif
+
+    char header[headerSize];
+    memset(header, 0, headerSize);
+    strcpy(header, "lithophane");
+    qToLittleEndian(noOfTriangles, header + headerSize - sizeof(uint32_t));
+    ok = ok && file.write(header, headerSize) == headerSize;
+
+    // Ranges of triangles, each packed by one thread
+    struct Range
+    {
+        uint32_t first, last;
+        char* out;
+    };
+    const uint32_t trianglesPerRange = 1 << 16;
+    const auto packRange = [&packFacet](const Range& range) {
+        char* out = range.out;
+        for (uint32_t t = range.first; t < range.last; ++t)
+        {
+            out = packFacet(out, t);
+        }
+    };
+
+    // One batch is mapped at a time, so the address space needed stays small
+    // even for files of several GB. Where mapping isn't possible the batch is
+    // packed into memory and written in one go.
+    const uint32_t batchSize = std::max(1, QThreadPool::globalInstance()->maxThreadCount() * 4) * trianglesPerRange;
+    QVector<Range> ranges;
+    QByteArray buffer;
+    for (uint32_t first = 0; ok && first < noOfTriangles; first += batchSize)
+    {
+        const uint32_t last = std::min(noOfTriangles - first, batchSize) + first;
+        const qint64 offset = headerSize + (qint64)first * facetSize;
+        const qint64 size = (qint64)(last - first) * facetSize;
+
+        char* data = (char*)file.map(offset, size);
+        if (data == nullptr)
+        {
+            buffer.resize(size);
+            data = buffer.data();
+        }
+
+        ranges.clear();
+        for (uint32_t t = first; t < last; t += trianglesPerRange)
+        {
+            ranges.append({t, std::min(t + trianglesPerRange, last), data + (qint64)(t - first) * facetSize});
+        }
+        QtConcurrent::blockingMap(ranges, packRange);
+
+        if (data == buffer.data())
+        {
+            ok = file.seek(offset) && file.write(buffer) == size;
+        }
+        else
+        {
+            ok = file.unmap((uchar*)data);
+        }
+
+        if (progress) progress((int)((float)last / (float)noOfTriangles * 100.0f));
+    }
+    file.close();
+    return ok && file.error() == QFileDevice::NoError;
+}
+
+bool writeAsciiStl(const QString& path, const Mesh& mesh, const std::function<void(int)>& progress, bool compress)
+{
+    const int noOfTriangles = mesh.triangleCount();
+
+    // Formatting, compressing and writing overlap
+    PipelineWriter output;
+    if (!output.open(path, compress)) return false;
+    output.write("solid lithophane\n");
+
+    ChunkWriter writer(maxTextFacetSize);
+    writer.write(
+        noOfTriangles,
+        [&mesh](char* out, int t) { return putTextFacet(out, mesh.normal(t), mesh.vertex(t, 0), mesh.vertex(t, 1), mesh.vertex(t, 2)); },
+        [&output](const char* data, qint64 size) { output.write(QByteArray(data, size)); return true; },
+        [&progress, noOfTriangles](int done) { if (progress) progress((int)((float)done / (float)noOfTriangles * 100.0f)); }
+    );
+
+    output.write("endsolid\n");
+    return output.close();
+}
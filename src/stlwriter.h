@@ -0,0 +1,67 @@
+#ifndef __STLWRITER_H__
+#define __STLWRITER_H__
+
+#include <cstdint>
+#include <functional>
+
+#include <QByteArray>
+#include <QString>
+#include <QVector3D>
+
+#include "mesh.h"
+#include "pipelinewriter.h"
+
+
+// Writes a binary STL file from a stream of facets. Facets are handed over in
+// chunks and written by a background thread while the caller produces the
+// next ones, so neither the mesh nor the file contents have to be held in
+// memory. Plain files get the facet count patched into the header on close(),
+// gzip compressed ones need it up front.
+class StlStreamWriter
+{
+public:
+    static constexpr int headerSize = 84;
+    static constexpr int facetSize = 50;
+
+    // At most 'queueCapacity' chunks wait for the disk at any time
+    explicit StlStreamWriter(int queueCapacity = 8);
+    ~StlStreamWriter();
+
+    bool open(const QString& path, bool compress = false, uint32_t noOfFacets = 0);
+
+    // Queues a chunk of whole facets, blocking while the queue is full
+    void write(QByteArray facets);
+
+    // Waits until all queued facets are written and completes the header.
+    // Returns false if the file could not be written completely, or if a
+    // compressed file didn't get the number of facets given to open().
+    bool close();
+
+    // Packs one facet with its flat normal in binary STL layout
+    static char* putFacet(char* out, const QVector3D& p1, const QVector3D& p2, const QVector3D& p3);
+    static char* putFacet(char* out, const QVector3D& normal, const QVector3D& p1, const QVector3D& p2, const QVector3D& p3);
+
+private:
+    PipelineWriter m_Output;
+    QString m_Path;
+    uint32_t m_HeaderFacets = 0;
+    uint32_t m_NoOfFacets = 0;
+    bool m_Open = false;
+};
+
+// Writes a whole mesh as binary STL. Every facet takes the same 50 bytes, so
+// the file is sized up front and threads pack their own ranges of triangles
+// straight into the memory mapped file. Compressed files are packed in chunks
+// and gzip compressed on other threads instead. 'progress' gets 0 - 100% from
+// the calling thread.
+bool writeBinaryStl(const QString& path, const Mesh& mesh, const std::function<void(int)>& progress = nullptr,
+                    bool compress = false);
+
+// Writes a whole mesh as ascii STL, with the numbers formatted like
+// 'std::ostream << float' does. Threads format chunks of facets into a fixed
+// set of reused buffers, which are appended to the file in order, so memory
+// use doesn't grow with the mesh.
+bool writeAsciiStl(const QString& path, const Mesh& mesh, const std::function<void(int)>& progress = nullptr,
+                   bool compress = false);
+
+#endif
@@ -0,0 +1,134 @@
+#include "threemfwriter.h"
+
+#include <charconv>
+#include <cstring>
+
+#include "chunkwriter.h"
+#include "zipwriter.h"
+
+
+namespace {
+
+const char contentTypes[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+    "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>"
+    "<Default Extension=\"model\" ContentType=\"application/vnd.ms-package.3dmanufacturing-3dmodel+xml\"/>"
+    "</Types>\n";
+
+const char relationships[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+    "<Relationship Target=\"/3D/3dmodel.model\" Id=\"rel0\" Type=\"http://schemas.microsoft.com/3dmanufacturing/2013/01/3dmodel\"/>"
+    "</Relationships>\n";
+
+const char modelBegin[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<model unit=\"millimeter\" xml:lang=\"en-US\" xmlns=\"http://schemas.microsoft.com/3dmanufacturing/core/2015/02\">\n"
+    " <metadata name=\"Application\">LithoMaker</metadata>\n"
+    " <resources>\n"
+    "  <object id=\"1\" type=\"model\">\n"
+    "   <mesh>\n"
+    "    <vertices>\n";
+
+const char modelMiddle[] =
+    "    </vertices>\n"
+    "    <triangles>\n";
+
+const char modelEnd[] =
+    "    </triangles>\n"
+    "   </mesh>\n"
+    "  </object>\n"
+    " </resources>\n"
+    " <build>\n"
+    "  <item objectid=\"1\"/>\n"
+    " </build>\n"
+    "</model>\n";
+
+// Longest line putVertex() or putTriangle() writes, with numbers of at most 16 characters
+constexpr int maxLineSize = 3 * 16 + 64;
+
+char* putText(char* out, const char* text)
+{
+    const size_t length = strlen(text);
+    memcpy(out, text, length);
+    return out + length;
+}
+
+// Shortest text reading back as the same float
+char* putVertex(char* out, const QVector3D& v)
+{
+    out = putText(out, "     <vertex x=\"");
+    out = std::to_chars(out, out + 16, v.x()).ptr;
+    out = putText(out, "\" y=\"");
+    out = std::to_chars(out, out + 16, v.y()).ptr;
+    out = putText(out, "\" z=\"");
+    out = std::to_chars(out, out + 16, v.z()).ptr;
+    return putText(out, "\"/>\n");
+}
+
+char* putTriangle(char* out, const uint32_t* indices)
+{
+    // 3MF doesn't allow triangles using a vertex twice
+    if (indices[0] == indices[1] || indices[1] == indices[2] || indices[2] == indices[0]) return out;
+
+    out = putText(out, "     <triangle v1=\"");
+    out = std::to_chars(out, out + 16, indices[0]).ptr;
+    out = putText(out, "\" v2=\"");
+    out = std::to_chars(out, out + 16, indices[1]).ptr;
+    out = putText(out, "\" v3=\"");
+    out = std::to_chars(out, out + 16, indices[2]).ptr;
+    return putText(out, "\"/>\n");
+}
+
+// PrusaSlicer reads the project configuration as '; key = value' lines
+QByteArray projectConfig(const QByteArray& printSettings)
+{
+    QByteArray config;
+    for (const QByteArray& line : printSettings.split('\n'))
+    {
+        const QByteArray trimmed = line.trimmed();
+        if (trimmed.isEmpty()) continue;
+        config.append(trimmed.startsWith('#') ? "; " + trimmed.mid(1).trimmed() : "; " + trimmed);
+        config.append('\n');
+    }
+    return config;
+}
+
+}
+
+bool write3mf(const QString& path, const Mesh& mesh, const QByteArray& printSettings, const std::function<void(int)>& progress)
+{
+    ZipWriter zip;
+    bool ok = zip.open(path) &&
+        zip.beginEntry("[Content_Types].xml") && zip.write(contentTypes, strlen(contentTypes)) &&
+        zip.beginEntry("_rels/.rels") && zip.write(relationships, strlen(relationships));
+    if (ok && !printSettings.isEmpty())
+    {
+        ok = zip.beginEntry("Metadata/Slic3r_PE.config") && zip.write(projectConfig(printSettings));
+    }
+    ok = ok && zip.beginEntry("3D/3dmodel.model") && zip.write(modelBegin, strlen(modelBegin));
+
+    const int noOfVertices = mesh.vertexCount();
+    const int noOfLines = noOfVertices + mesh.triangleCount();
+    const auto output = [&zip](const char* data, qint64 size) { return zip.write(data, size); };
+    const auto reportProgress = [&progress, noOfLines](int done) {
+        if (progress) progress((int)((float)done / (float)noOfLines * 100.0f));
+    };
+
+    ChunkWriter writer(maxLineSize);
+    ok = ok && writer.write(
+        noOfVertices,
+        [&mesh](char* out, int i) { return putVertex(out, mesh.vertices.at(i)); },
+        output, reportProgress
+    );
+    ok = ok && zip.write(modelMiddle, strlen(modelMiddle));
+    ok = ok && writer.write(
+        mesh.triangleCount(),
+        [&mesh](char* out, int t) { return putTriangle(out, mesh.indices.constData() + t * 3); },
+        output, [&reportProgress, noOfVertices](int done) { reportProgress(noOfVertices + done); }
+    );
+    ok = ok && zip.write(modelEnd, strlen(modelEnd));
+
+    return zip.close() && ok;
+}
@@ -0,0 +1,20 @@
+#ifndef __THREEMFWRITER_H__
+#define __THREEMFWRITER_H__
+
+#include <functional>
+
+#include <QByteArray>
+#include <QString>
+
+#include "mesh.h"
+
+
+// Writes a mesh as a 3MF file: the shared vertices and the triangles indexing
+// them as XML in a deflate compressed zip archive. Unlike STL, every vertex is
+// stored once. 'printSettings' is a PrusaSlicer .ini and is embedded as the
+// project configuration when not empty. 'progress' gets 0 - 100% from the
+// calling thread.
+bool write3mf(const QString& path, const Mesh& mesh, const QByteArray& printSettings = QByteArray(),
+              const std::function<void(int)>& progress = nullptr);
+
+#endif
@@ -0,0 +1,125 @@
+#include "vertexcache.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QVector>
+
+
+namespace {
+
+// Vertices the scores are tuned for, about what current GPUs keep
+constexpr int cacheSize = 32;
+
+float vertexScore(int cachePosition, int activeTriangles)
+{
+    if (activeTriangles == 0) return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // The vertices of the last triangle get a fixed score, so the next
+        // triangle doesn't simply share an edge with it every time
+        if (cachePosition < 3) score = 0.75f;
+        else score = std::pow(1.0f - float(cachePosition - 3) / (cacheSize - 3), 1.5f);
+    }
+    // Vertices with few triangles left are finished off first
+    return score + 2.0f / std::sqrt((float)activeTriangles);
+}
+
+}
+
+void optimizeVertexCache(uint32_t* indices, int noOfTriangles, int noOfVertices)
+{
+    // Triangles around each vertex, of which the first 'active' aren't drawn yet
+    QVector<int> offsets(noOfVertices + 1, 0);
+    for (int i = 0; i < noOfTriangles * 3; ++i)
+    {
+        ++offsets[indices[i] + 1];
+    }
+    for (int v = 0; v < noOfVertices; ++v)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    QVector<int> adjacency(noOfTriangles * 3);
+    QVector<int> active(noOfVertices, 0);
+    for (int t = 0; t < noOfTriangles; ++t)
+    {
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t v = indices[t * 3 + corner];
+            adjacency[offsets[v] + active[v]++] = t;
+        }
+    }
+
+    QVector<int> cachePosition(noOfVertices, -1);
+    QVector<float> scores(noOfVertices);
+    for (int v = 0; v < noOfVertices; ++v)
+    {
+        scores[v] = vertexScore(-1, active[v]);
+    }
+
+    QVector<uint8_t> drawn(noOfTriangles, 0);
+    QVector<uint32_t> order(noOfTriangles * 3);
+    int cache[cacheSize + 3], newCache[cacheSize + 3];
+    int cacheCount = 0;
+    int best = -1;
+    int next = 0;
+
+    for (int n = 0; n < noOfTriangles; ++n)
+    {
+        // Nothing left around the cached vertices, continue in input order
+        if (best < 0)
+        {
+            while (drawn[next]) ++next;
+            best = next;
+        }
+        drawn[best] = 1;
+        const uint32_t *triangle = indices + best * 3;
+        std::copy(triangle, triangle + 3, order.begin() + n * 3);
+
+        int newCount = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const int v = triangle[corner];
+            int *triangles = adjacency.data() + offsets[v];
+            std::swap(*std::find(triangles, triangles + active[v], best), triangles[active[v] - 1]);
+            --active[v];
+            if (std::find(newCache, newCache + newCount, v) == newCache + newCount) newCache[newCount++] = v;
+        }
+
+        // The triangle's vertices move to the front, pushing the last ones out
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            if (std::find(triangle, triangle + 3, (uint32_t)cache[i]) == triangle + 3) newCache[newCount++] = cache[i];
+        }
+        for (int i = 0; i < newCount; ++i)
+        {
+            const int v = newCache[i];
+            cachePosition[v] = i < cacheSize ? i : -1;
+            scores[v] = vertexScore(cachePosition[v], active[v]);
+        }
+        cacheCount = std::min(newCount, cacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        // Only triangles around cached vertices changed their score
+        best = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            const int v = cache[i];
+            for (int k = 0; k < active[v]; ++k)
+            {
+                const int t = adjacency[offsets[v] + k];
+                const float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+                if (score > bestScore)
+                {
+                    best = t;
+                    bestScore = score;
+                }
+            }
+        }
+    }
+
+    std::copy(order.begin(), order.end(), indices);
+}
@@ -0,0 +1,12 @@
+#ifndef __VERTEXCACHE_H__
+#define __VERTEXCACHE_H__
+
+#include <cstdint>
+
+
+// Reorders the triangles of an indexed mesh so the GPU finds most of their
+// vertices in its post-transform cache, with Tom Forsyth's linear-speed
+// vertex cache optimisation. Each triangle keeps its corners and winding.
+void optimizeVertexCache(uint32_t* indices, int noOfTriangles, int noOfVertices);
+
+#endif
@@ -0,0 +1,226 @@
+#include "zipwriter.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <QtEndian>
+
+
+namespace {
+
+constexpr uint32_t localHeaderSignature = 0x04034b50;
+constexpr uint32_t centralHeaderSignature = 0x02014b50;
+constexpr uint32_t endSignature = 0x06054b50;
+constexpr uint32_t zip64EndSignature = 0x06064b50;
+constexpr uint32_t zip64LocatorSignature = 0x07064b50;
+constexpr uint16_t zip64ExtraId = 0x0001;
+constexpr uint16_t version = 45; // Zip64
+constexpr uint16_t utf8Flag = 1 << 11;
+constexpr uint16_t deflated = 8;
+constexpr uint16_t dosDate = (0 << 9) | (1 << 5) | 1; // 1980-01-01 00:00, for reproducible files
+constexpr uint32_t max32 = std::numeric_limits<uint32_t>::max();
+constexpr int localHeaderSize = 30;
+
+template<typename T>
+void append(QByteArray& out, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, sizeof(T));
+}
+
+}
+
+ZipWriter::ZipWriter() :
+    m_Output(256 * 1024, 0)
+{
+    m_Stream.zalloc = Z_NULL;
+    m_Stream.zfree = Z_NULL;
+    m_Stream.opaque = Z_NULL;
+    // Raw deflate data, the zip headers take the place of the zlib ones
+    deflateInit2(&m_Stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+}
+
+ZipWriter::~ZipWriter()
+{
+    if (m_File.isOpen()) close();
+    deflateEnd(&m_Stream);
+}
+
+bool ZipWriter::open(const QString& path)
+{
+    m_File.setFileName(path);
+    m_Entries.clear();
+    m_InEntry = false;
+    m_Ok = m_File.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    return m_Ok;
+}
+
+bool ZipWriter::beginEntry(const QString& name)
+{
+    if (m_InEntry) endEntry();
+    if (!m_Ok) return false;
+
+    const Entry entry = {name.toUtf8(), (uint32_t)crc32(0L, Z_NULL, 0), 0, 0, (quint64)m_File.pos()};
+
+    // The checksum and the Zip64 sizes are filled in by endEntry(). The Zip64
+    // field is always there, as the final size isn't known yet, and the sizes
+    // stay at 0xffffffff so they point to it, as the format requires.
+    QByteArray header;
+    append(header, localHeaderSignature);
+    append(header, version);
+    append(header, utf8Flag);
+    append(header, deflated);
+    append<uint16_t>(header, 0); // Time
+    append(header, dosDate);
+    append<uint32_t>(header, 0); // CRC-32
+    append(header, max32); // Compressed size
+    append(header, max32); // Uncompressed size
+    append<uint16_t>(header, entry.name.size());
+    append<uint16_t>(header, 4 + 16);
+    header.append(entry.name);
+    append(header, zip64ExtraId);
+    append<uint16_t>(header, 16);
+    append<quint64>(header, 0);
+    append<quint64>(header, 0);
+
+    m_Ok = m_File.write(header) == header.size() && deflateReset(&m_Stream) == Z_OK;
+    m_Entries.append(entry);
+    m_InEntry = m_Ok;
+    return m_Ok;
+}
+
+bool ZipWriter::write(const char* data, qint64 size)
+{
+    if (!m_InEntry || !m_Ok) return false;
+
+    Entry& entry = m_Entries.last();
+    while (m_Ok && size > 0)
+    {
+        const uInt length = (uInt)std::min<qint64>(size, 1 << 30);
+        entry.crc = crc32(entry.crc, (const Bytef*)data, length);
+        entry.size += length;
+        m_Stream.next_in = (Bytef*)data;
+        m_Stream.avail_in = length;
+        m_Ok = deflateInput(Z_NO_FLUSH);
+        data += length;
+        size -= length;
+    }
+    return m_Ok;
+}
+
+bool ZipWriter::deflateInput(int flush)
+{
+    Entry& entry = m_Entries.last();
+    for (;;)
+    {
+        m_Stream.next_out = (Bytef*)m_Output.data();
+        m_Stream.avail_out = m_Output.size();
+        const int result = deflate(&m_Stream, flush);
+        if (result == Z_STREAM_ERROR) return false;
+
+        const qint64 produced = m_Output.size() - m_Stream.avail_out;
+        if (m_File.write(m_Output.constData(), produced) != produced) return false;
+        entry.compressedSize += produced;
+
+        if (flush == Z_FINISH ? result == Z_STREAM_END : m_Stream.avail_out != 0) return true;
+    }
+}
+
+bool ZipWriter::endEntry()
+{
+    m_InEntry = false;
+    m_Ok = m_Ok && deflateInput(Z_FINISH);
+    if (!m_Ok) return false;
+
+    const Entry& entry = m_Entries.last();
+    const qint64 end = m_File.pos();
+
+    QByteArray crc;
+    append(crc, entry.crc);
+    QByteArray zip64Sizes;
+    append(zip64Sizes, entry.size);
+    append(zip64Sizes, entry.compressedSize);
+
+    m_Ok = m_File.seek(entry.offset + 14) && m_File.write(crc) == crc.size() &&
+        m_File.seek(entry.offset + localHeaderSize + entry.name.size() + 4) && m_File.write(zip64Sizes) == zip64Sizes.size() &&
+        m_File.seek(end);
+    return m_Ok;
+}
+
+bool ZipWriter::close()
+{
+    if (!m_File.isOpen()) return false;
+    if (m_InEntry) endEntry();
+
+    const quint64 directoryOffset = m_File.pos();
+    QByteArray directory;
+    for (const Entry& entry : m_Entries)
+    {
+        // Only the fields that don't fit go into the Zip64 field, in this order
+        QByteArray zip64;
+        if (entry.size >= max32) append(zip64, entry.size);
+        if (entry.compressedSize >= max32) append(zip64, entry.compressedSize);
+        if (entry.offset >= max32) append(zip64, entry.offset);
+
+        append(directory, centralHeaderSignature);
+        append(directory, version); // Made by
+        append(directory, version); // Needed to extract
+        append(directory, utf8Flag);
+        append(directory, deflated);
+        append<uint16_t>(directory, 0); // Time
+        append(directory, dosDate);
+        append(directory, entry.crc);
+        append<uint32_t>(directory, std::min<quint64>(entry.compressedSize, max32));
+        append<uint32_t>(directory, std::min<quint64>(entry.size, max32));
+        append<uint16_t>(directory, entry.name.size());
+        append<uint16_t>(directory, zip64.isEmpty() ? 0 : 4 + zip64.size());
+        append<uint16_t>(directory, 0); // Comment length
+        append<uint16_t>(directory, 0); // Disk number
+        append<uint16_t>(directory, 0); // Internal attributes
+        append<uint32_t>(directory, 0); // External attributes
+        append<uint32_t>(directory, std::min<quint64>(entry.offset, max32));
+        directory.append(entry.name);
+        if (!zip64.isEmpty())
+        {
+            append(directory, zip64ExtraId);
+            append<uint16_t>(directory, zip64.size());
+            directory.append(zip64);
+        }
+    }
+
+    const quint64 directorySize = directory.size();
+    const quint64 noOfEntries = m_Entries.count();
+    if (directoryOffset >= max32 || directorySize >= max32 || noOfEntries >= 0xffff)
+    {
+        const quint64 zip64EndOffset = directoryOffset + directorySize;
+        append(directory, zip64EndSignature);
+        append<quint64>(directory, 44); // Size of the rest of the record
+        append(directory, version);
+        append(directory, version);
+        append<uint32_t>(directory, 0); // This disk
+        append<uint32_t>(directory, 0); // Disk with the central directory
+        append(directory, noOfEntries);
+        append(directory, noOfEntries);
+        append(directory, directorySize);
+        append(directory, directoryOffset);
+
+        append(directory, zip64LocatorSignature);
+        append<uint32_t>(directory, 0); // Disk with the Zip64 end record
+        append(directory, zip64EndOffset);
+        append<uint32_t>(directory, 1); // Number of disks
+    }
+
+    append(directory, endSignature);
+    append<uint16_t>(directory, 0); // This disk
+    append<uint16_t>(directory, 0); // Disk with the central directory
+    append<uint16_t>(directory, std::min<quint64>(noOfEntries, 0xffff));
+    append<uint16_t>(directory, std::min<quint64>(noOfEntries, 0xffff));
+    append<uint32_t>(directory, std::min<quint64>(directorySize, max32));
+    append<uint32_t>(directory, std::min<quint64>(directoryOffset, max32));
+    append<uint16_t>(directory, 0); // Comment length
+
+    m_Ok = m_Ok && m_File.write(directory) == directory.size();
+    m_File.close();
+    return m_Ok && m_File.error() == QFileDevice::NoError;
+}
@@ -0,0 +1,56 @@
+#ifndef __ZIPWRITER_H__
+#define __ZIPWRITER_H__
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include <zlib.h>
+
+
+// Writes a zip archive of deflate compressed entries. Entry data is compressed
+// as it is written, so an entry never has to be held in memory, and sizes and
+// checksums are patched into the local header when the entry ends. Entries and
+// archives above 4 GB use the Zip64 extensions.
+class ZipWriter
+{
+public:
+    ZipWriter();
+    ~ZipWriter();
+
+    bool open(const QString& path);
+
+    // Starts a new entry, ending the current one
+    bool beginEntry(const QString& name);
+    bool write(const char* data, qint64 size);
+    bool write(const QByteArray& data) { return write(data.constData(), data.size()); }
+
+    // Ends the current entry and writes the central directory. Returns false
+    // if anything could not be written.
+    bool close();
+
+private:
+    struct Entry
+    {
+        QByteArray name;
+        uint32_t crc;
+        quint64 compressedSize;
+        quint64 size;
+        quint64 offset;
+    };
+
+    bool endEntry();
+    bool deflateInput(int flush);
+
+    QFile m_File;
+    z_stream m_Stream;
+    QByteArray m_Output;
+    QVector<Entry> m_Entries;
+    bool m_InEntry = false;
+    bool m_Ok = false;
+};
+
+#endif